@@ -14,7 +14,6 @@
 	MAC_ENTITY(ENTITY_DUMMY)         \
 	MAC_ENTITY(ENTITY_FIREBALL)      \
 	MAC_ENTITY(ENTITY_DAMAGE_NUMBER) \
-	MAC_ENTITY(ENTITY_PARTICLE)      \
 	MAC_ENTITY(ENTITY_DOOR)
 
 typedef enum {
@@ -43,8 +42,7 @@ union Entity {
 
 	ENTITY_STRUCT(ENTITY_FIREBALL) {
 		SceneSprite *sprite;
-		Entity *caster;
-		float time;
+		ObjectID caster;
 
 		float damage;
 		Body *body;
@@ -53,22 +51,13 @@ union Entity {
 	ENTITY_STRUCT(ENTITY_DUMMY) {
 		SceneSprite *sprite;
 		Body *body;
-		
-		Mob mob;
 	} dummy;
 
-	ENTITY_STRUCT(ENTITY_PARTICLE) {
-		Body *body;
-		SceneSprite *sprite;
-		float time;
-	} particle;
-
 	ENTITY_STRUCT(ENTITY_PLAYER) {
 		SceneAnimatedSprite *sprite;
 
 		int fired;
 		bool moving;
-		Mob mob;
 		Body *body;
 	} player;
 
@@ -85,18 +74,62 @@ union Entity {
 typedef struct ENTITY_DAMAGE_NUMBER_struct DamageNumber;
 typedef struct ENTITY_FIREBALL_struct Fireball;
 typedef struct ENTITY_DUMMY_struct Dummy;
-typedef struct ENTITY_PARTICLE_struct Particle;
 typedef struct ENTITY_PLAYER_struct Player;
 typedef struct ENTITY_DOOR_struct Door;
 
+/* 
+ * the pointers of the entities into the physics and scene pools, moved by
+ * ent_restore() with the relocate function of their pool. Every pointer
+ * field added to an entity that isn't a handle has to be listed here
+ */
+#define ENTITY_POINTER_LIST                                                          \
+	MAC_ENTITY_POINTER(ENTITY_PLAYER,        player.body,        phx_relocate)        \
+	MAC_ENTITY_POINTER(ENTITY_PLAYER,        player.sprite,      gfx_scene_relocate)  \
+	MAC_ENTITY_POINTER(ENTITY_DUMMY,         dummy.body,         phx_relocate)        \
+	MAC_ENTITY_POINTER(ENTITY_DUMMY,         dummy.sprite,       gfx_scene_relocate)  \
+	MAC_ENTITY_POINTER(ENTITY_FIREBALL,      fireball.body,      phx_relocate)        \
+	MAC_ENTITY_POINTER(ENTITY_FIREBALL,      fireball.sprite,    gfx_scene_relocate)  \
+	MAC_ENTITY_POINTER(ENTITY_DAMAGE_NUMBER, damage_number.text, gfx_scene_relocate)  \
+	MAC_ENTITY_POINTER(ENTITY_DOOR,          door.body,          phx_relocate)        \
+	MAC_ENTITY_POINTER(ENTITY_DOOR,          door.line,          gfx_scene_relocate)
+
+/* when update is called, delta is the time since the entity's last update */
+typedef enum {
+	/* every ent_update(), the default */
+	TICK_EVERY_FRAME,
+	/* tick_rate times a second */
+	TICK_RATE,
+	/* every frame near the view given to ent_set_view(), at TICK_FAR_RATE away from it */
+	TICK_NEAR_VIEW,
+	/* only between ent_wake() and ent_sleep() */
+	TICK_ON_WAKE,
+} TickPolicy;
+
+typedef struct {
+	size_t ticked, skipped;
+} EntityTickStats;
+
 typedef struct {
 	void (*update)(Entity*, float delta);
 	void (*render)(Entity*);
 	void (*take_damage)(Entity*, float damage);
 	void (*die)(Entity*);
+	/* right before an entity with a lifetime is deleted because it ran out */
+	void (*expire)(Entity*);
 
 	bool (*mouse_hovered)(Entity *, vec2 mouse_click);
 	void (*mouse_interact)(Entity *self, Player *who, vec2 mouse_click);
+
+	/* 
+	 * update only reads the world and writes the entity's own data, so the
+	 * type is updated in chunks on the job workers. ent_del() and
+	 * ent_take_damage() are queued from there, any other side effect
+	 * (spawns, sfx, events) has to go through ent_defer(). Like any job it
+	 * must not allocate through a tagged or counting allocator
+	 */
+	bool parallel_update;
+	TickPolicy tick;
+	float tick_rate;
 } EntityInterface;
 
 
@@ -112,11 +145,64 @@ void       ent_take_damage(Entity* id, float damage, vec2 damage_indicator_pos);
 #define ENT_IMPLEMENTS(ID, FUNCTION_NAME) \
 	ent_implements(ID, offsetof(EntityInterface, FUNCTION_NAME))
 
-void mob_process(Entity *entity, Mob *mob);
+/* 
+ * components are kept in dense arrays, one per kind, and run by a system 
+ * over the whole array instead of from each entity's update. An entity has
+ * at most one of each kind, they are all removed by ent_del()
+ */
+/* health is kept under health_max, the entity is deleted when it reaches 0 */
+Mob  *ent_add_mob(Entity *entity, float health);
+Mob  *ent_mob(Entity *entity);
+/* deleted with the entity, body->entity is set to it */
+void  ent_bind_body(Entity *entity, Body *body);
+/* 
+ * deleted with the entity, if follow isn't NULL position is moved to the 
+ * interpolated position of follow before drawing 
+ */
+void  ent_bind_sprite(Entity *entity, SceneObject *object, float *position, Body *follow);
+/* a timer deletes the entity after time seconds, after its expire callback */
+void  ent_set_lifetime(Entity *entity, float time);
 
 Entity       *ent_new(EntityType type, EntityInterface *interface);
+/*
+ * the entity stops updating and its body goes inactive right away, it is
+ * freed with its body and sprite on the next ent_flush()
+ */
 void          ent_del(Entity *entity);
+/*
+ * queues command to run with a copy of size bytes of data on the next
+ * ent_flush(), for spawning from inside a physics callback or a system
+ */
+void          ent_defer(void (*command)(void *data), void *data, size_t size);
+/*
+ * runs the deferred commands and frees the deleted entities, one pool at a
+ * time. Called after the physics step and at the end of ent_update()
+ */
+void          ent_flush(void);
+/* world rectangle on screen, NULL ticks every TICK_NEAR_VIEW entity at full rate */
+void          ent_set_view(Rectangle *view);
+/* TICK_ON_WAKE entities start asleep */
+void          ent_wake(Entity *entity);
+void          ent_sleep(Entity *entity);
+/* entities whose update ran or was skipped by their tick policy in the last ent_update() */
+EntityTickStats ent_tick_stats(void);
+/* 
+ * replaces out with a copy of the world after an ent_flush(): the entities 
+ * with their components, the particles, bodies, scene objects and timers.
+ * ent_restore() puts it back in the same process with little more than a
+ * memcpy of the pools, the ObjectIDs are the ones at the time of the 
+ * snapshot. Pointers kept outside of the world have to be taken again from
+ * a handle or moved with ent_relocate(). The map given to 
+ * ent_particles_set_map() is not part of it.
+ */
+void          ent_snapshot(ArrayBuffer *out);
+void          ent_restore(ArrayBuffer *snapshot);
+/* an Entity pointer of the last restored snapshot, see objpool_relocate() */
+bool          ent_relocate(void **ptr);
 EntityType    ent_type(Entity *entity);
+ObjectID      ent_id(Entity *entity);
+Entity       *ent_from_id(ObjectID id);
+ObjectPoolStats ent_pool_stats(void);
 
 Player       *ent_player_new(vec2 position);
 Fireball     *ent_fireball_new(Entity *caster, vec2 position, vec2 vel);
@@ -124,8 +210,28 @@ Dummy        *ent_dummy_new(vec2 position);
 DamageNumber *ent_damage_number(vec2 position, float damage);
 Door         *ent_door_new(vec2 position, Direction direction);
 
-Particle     *ent_particle_new(vec2 position, vec2 velocity, vec4 color, float time);
+/* 
+ * built with ENT_STATIC_DISPATCH (make STATIC_DISPATCH=yes) ent_update() 
+ * calls these directly, in a loop per type, instead of through the
+ * EntityInterface, so with LTO they can be inlined. Every entity of a
+ * listed type must have that function as its update
+ */
+#define ENTITY_UPDATE_LIST                                          \
+	MAC_ENTITY_UPDATE(ENTITY_PLAYER,        ent_player_update)        \
+	MAC_ENTITY_UPDATE(ENTITY_DAMAGE_NUMBER, ent_damage_number_update) \
+	MAC_ENTITY_UPDATE(ENTITY_DOOR,          ent_door_update)
+
+#define MAC_ENTITY_UPDATE(TYPE, FUNCTION) void FUNCTION(Entity *entity, float delta);
+	ENTITY_UPDATE_LIST
+#undef MAC_ENTITY_UPDATE
+
+/* 
+ * particles are not entities, they are kept in arrays of their own and only
+ * bounce off the map given to ent_particles_set_map()
+ */
 void          ent_shot_particles(vec2 position, vec2 velocity, vec4 color, float time, int count);
+void          ent_particles_set_map(Rectangle *solids, size_t count);
+size_t        ent_particles_count(void);
 
 Entity *ent_hover(vec2 position);
 void    ent_mouse_interact(Player *who, vec2 mouse_click);
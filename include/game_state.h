@@ -2,6 +2,7 @@
 #define GAME_STATE_H
 
 #include <SDL.h>
+#include <stdbool.h>
 
 typedef struct {
 	void (*init)(void);
@@ -13,10 +14,15 @@ typedef struct {
 	void (*mouse_button)(SDL_Event *event);
 	void (*mouse_wheel)(SDL_Event *event);
 	void (*text_input)(SDL_Event *event);
+
+	/* with ZERO_MALLOC=yes, any heap allocation after the warm-up is fatal */
+	bool steady_state;
 } GameStateVTable;
 
 void start_game_level(void);
 void start_game_level_edit(void);
 void game_change_state_vtable(GameStateVTable *new_vtable);
+/* starts the ZERO_MALLOC warm-up again, after the state swapped its world in the middle of a frame */
+void game_restart_steady_state(void);
 
 #endif
@@ -15,6 +15,9 @@ typedef struct {
 
 extern Global GLOBAL;
 Allocator cache_aligned_allocator(void);
+/* scratch memory valid until the end of the current main loop iteration */
+Arena    *frame_arena(void);
+Allocator frame_allocator(void);
 void      enable_text_input(void);
 void      disable_text_input(void);
 
@@ -132,6 +132,11 @@ void gfx_begin(void);
 void gfx_push_clip(vec2 position, vec2 half_size);
 void gfx_pop_clip(void);
 void gfx_push_texture_rect(TextureStamp *texture, vec2 position, vec2 size, vec2 uv_scale, float rotation, vec4 color);
+/* 
+ * count sprites of one stamp and size, written straight into the instance 
+ * buffer from arrays of count positions, rotations and colors
+ */
+void gfx_push_sprite_batch(TextureStamp *stamp, vec2 half_size, size_t count, float *x, float *y, float *rotation, vec4 *color);
 void gfx_push_font(Font font, vec2 position, float height, vec4 color, StrView utf_text);
 void gfx_push_font2(Font font, vec2 position, float height, vec4 color, const char *fmt, ...);
 void gfx_push_line(vec2 p1, vec2 p2, float thickness, vec4 color);
@@ -151,6 +156,19 @@ typedef void SceneObject;
 SceneObject *gfx_scene_new_obj(int layer, SceneObjectType type);
 void         gfx_scene_del_obj(SceneObject *object);
 void         gfx_scene_update(float delta);
+/* draw is called while drawing the scene, right after the objects of layer */
+void         gfx_scene_set_layer_hook(int layer, void (*draw)(void));
+ObjectID     gfx_scene_obj_id(SceneObject *object);
+SceneObject *gfx_scene_obj(ObjectID id);
+ObjectPoolStats gfx_scene_pool_stats(void);
+/* 
+ * the objects and their layers, restored in the same process. The text_ptr
+ * of the texts is passed to relocate_text
+ */
+void         gfx_scene_snapshot(ArrayBuffer *out);
+void         gfx_scene_restore(Span *snapshot, Relocator relocate_text);
+/* a SceneObject pointer of the last restored snapshot, see objpool_relocate() */
+bool         gfx_scene_relocate(void **ptr);
 
 TextureStamp get_sprite(SpriteType sprite, int sprite_x, int sprite_y);
 TextureStamp *gfx_white_texture(void);
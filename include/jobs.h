@@ -0,0 +1,17 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+/* 
+ * fixed pool of worker threads for data parallel loops. The calling thread
+ * takes jobs too, so with 0 workers everything runs inline.
+ * A job must not allocate through a tagged or counting allocator, their
+ * counters are not thread safe, use allocator_pending() instead.
+ */
+void jobs_init(int workers);
+void jobs_end(void);
+int  jobs_worker_count(void);
+
+/* calls job(i, userptr) for every i in [0, count), returns when all of them are done */
+void jobs_parallel_for(int count, void (*job)(int index, void *userptr), void *userptr);
+
+#endif
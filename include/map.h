@@ -1,6 +1,8 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <stdint.h>
+
 #include "defs.h"
 #include "vecmath.h"
 
@@ -48,6 +50,12 @@ Map *map_alloc(void);
 Map *map_load(const char *file);
 void map_free(Map *);
 
+/* zeroed, accounted under ALLOC_TAG_MAP */
+Thing    *map_new_thing(void);
+MapBrush *map_new_brush(void);
+void      map_del_thing(Thing *thing);
+void      map_del_brush(MapBrush *brush);
+
 void map_insert_thing(Map *map, Thing *thing);
 void map_remove_thing(Map *map, Thing *thing);
 void map_insert_thing_after(Map *map, Thing *thing, Thing *after);
@@ -60,5 +68,7 @@ void map_thing_insert_brush_before(Thing *thing, MapBrush *brush, MapBrush *befo
 
 char *map_export(Map *map, size_t *out_data_size);
 void map_set_ent_scene(Map *map);
+/* of everything map_set_ent_scene() reads, to tell if the map changed since it was instantiated */
+uint64_t map_hash(Map *map);
 
 #endif
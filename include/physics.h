@@ -4,9 +4,15 @@
 #include <stdbool.h>
 
 #include "vecmath.h"
+#include "util.h"
 #include "defs.h"
 
-#define GRID_TILE_SIZE 16
+/* steps per second, phx_set_rate() changes it */
+#define PHX_DEFAULT_RATE 120
+#define PHX_DEFAULT_MAX_SUBSTEPS 8
+
+/* world units, phx_set_cell_size() or phx_auto_cell_size() change it */
+#define PHX_DEFAULT_CELL_SIZE 2.0f
 
 #define PHX_LAYERS \
 	PHX_LAYER(MAP) \
@@ -18,6 +24,7 @@ typedef enum {
 		PHX_LAYER_##LAYER_NAME,
 	PHX_LAYERS
 	#undef PHX_LAYER
+	PHX_LAYER_COUNT
 } PhxLayers;
 
 enum {
@@ -33,25 +40,52 @@ typedef struct {
 	vec2 normal, pierce;
 } Contact;
 
+/* 
+ * the position, velocity, accel and damping are kept by the physics in arrays
+ * of their own, see phx_position() and the others below
+ */
 struct Body {
-	vec2 accel;
-	vec2 position;
 	vec2 half_size;
-	vec2 velocity;
 
 	float mass, restitution;
-	float damping;
 
+	/* 
+	 * two bodies touch when either one's collision_mask has the other's 
+	 * collision_layer, the pre_solve callbacks are called then. The contact is
+	 * only solved when the same holds for the solve masks, otherwise it 
+	 * reaches the callbacks with active false, like a sensor.
+	 */
 	unsigned int solve_layer;
 	unsigned long long int solve_mask;
 	unsigned int collision_layer;
 	unsigned long long int collision_mask;
 
+	/* every step the two bodies overlap */
 	void (*pre_solve)(Body *self, Body *other, Contact *contact);
+	/* 
+	 * once when a contact starts and once when the bodies stop touching, 
+	 * other is NULL when it was deleted 
+	 */
+	void (*contact_enter)(Body *self, Body *other, Contact *contact);
+	void (*contact_exit)(Body *self, Body *other);
 	bool is_static, no_update;
 	bool active;
+	/* swept against the static grid every step, for small or fast bodies */
+	bool continuous;
 
 	Entity *entity;
+
+	/* owned by physics.c: the static grid nodes and the box they were built for */
+	unsigned int static_nodes;
+	vec2 static_position, static_half_size;
+	/* owned by physics.c: the slot of the body in the integration arrays */
+	unsigned int state;
+	bool sleeping;
+	/* owned by physics.c: the last step it touched something */
+	unsigned int contact_step;
+	/* owned by physics.c: where the last step started from, see phx_interpolate() */
+	vec2 previous_position;
+	bool has_previous;
 };
 
 typedef struct {
@@ -59,6 +93,40 @@ typedef struct {
 	vec2 normal, pierce;
 } SolveInfo;
 
+/* which bodies a query reports */
+typedef struct {
+	/* bodies with a bit of their collision_layer in mask */
+	unsigned long long int mask;
+	/* inactive bodies too, only static ones are in the grid while inactive (open doors) */
+	bool inactive;
+	/* never reported, usually the body asking */
+	Body *ignore;
+} PhxFilter;
+
+typedef struct {
+	Body *body;
+	/* fraction of the ray, 0 if it starts inside the body */
+	float time;
+	vec2 point, normal;
+} PhxRayHit;
+
+typedef struct {
+	vec2 from, to;
+	bool hit;
+	PhxRayHit result;
+} PhxRay;
+
+/* counts of the last physics step */
+typedef struct {
+	size_t bodies, grid_nodes, static_nodes;
+	size_t sleeping, awake;
+	/* of the last phx_update() call */
+	size_t substeps, swept_hits;
+	size_t pair_tests, contacts;
+	/* contacts kept between steps, and how many started and ended on the last step */
+	size_t cached_contacts, contact_enters, contact_exits;
+} PhxStats;
+
 void phx_init(void);
 void phx_end(void);
 void phx_reset(void);
@@ -67,4 +135,64 @@ Body *phx_new(void);
 void  phx_del(Body *body);
 void  phx_update(float delta);
 
+/* 
+ * the integration state of the body, these point into arrays owned by the
+ * physics and are only valid until the next phx_new()
+ */
+float *phx_position(Body *body);
+float *phx_velocity(Body *body);
+/* cleared after every phx_update() */
+float *phx_accel(Body *body);
+void   phx_set_damping(Body *body, float damping);
+
+/* 
+ * bodies at rest fall asleep and are not integrated or rebinned, writing to
+ * velocity, accel or position wakes them on the next step, so this is only
+ * needed to wake one right away 
+ */
+void     phx_wake(Body *body);
+
+void     phx_set_rate(float hz);
+float    phx_rate(void);
+/* steps a single phx_update() may run, the time past it is dropped */
+void     phx_set_max_substeps(int substeps);
+/* how far into the next step the time left over by phx_update() is, from 0 to 1 */
+float    phx_alpha(void);
+/* 
+ * the body between its last two steps by phx_alpha(), so what is drawn
+ * moves smoothly at any rate. A body that was not stepped yet gives its position
+ */
+void     phx_interpolate(Body *body, vec2 position);
+
+ObjectID phx_id(Body *body);
+Body    *phx_body(ObjectID id);
+ObjectPoolStats phx_pool_stats(void);
+
+/* 
+ * the bodies, grids and contacts, restored in the same process. Body.entity 
+ * is passed to relocate_entity, the entities have to be restored before 
+ */
+void     phx_snapshot(ArrayBuffer *out);
+void     phx_restore(Span *snapshot, Relocator relocate_entity);
+/* a Body pointer of the last restored snapshot, see objpool_relocate() */
+bool     phx_relocate(void **ptr);
+
+void     phx_set_cell_size(float size);
+float    phx_cell_size(void);
+/* derives the cell size from the bodies that exist now, call it after a map is loaded */
+void     phx_auto_cell_size(void);
+PhxStats phx_stats(void);
+
+/* 
+ * queries are answered from the grids of the last step, with the bodies at
+ * their current position. Bodies created after the last step are not seen.
+ * They fill up to max_bodies and return how many were written.
+ */
+size_t   phx_query_aabb(vec2 position, vec2 half_size, PhxFilter filter, Body **bodies, size_t max_bodies);
+size_t   phx_query_point(vec2 point, PhxFilter filter, Body **bodies, size_t max_bodies);
+/* closest body crossed going from from to to */
+bool     phx_raycast(vec2 from, vec2 to, PhxFilter filter, PhxRayHit *hit);
+/* phx_raycast() of every ray, spread over the job pool */
+void     phx_raycast_batch(PhxRay *rays, size_t count, PhxFilter filter);
+
 #endif
@@ -0,0 +1,35 @@
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include "util.h"
+
+/* timers run out on ticks of 1 / TIMERS_TICK_RATE seconds */
+#define TIMERS_TICK_RATE 100
+
+/* 
+ * hierarchical timer wheel, scheduling and cancelling are O(1) whatever the
+ * delay and the count of timers, and only the timers that run out cost 
+ * anything on an update
+ */
+typedef ObjectID TimerID;
+
+void    timers_init(void);
+void    timers_end(void);
+/* drops every timer without calling them */
+void    timers_reset(void);
+/* advances the time a tick at a time, calling the timers that ran out on each */
+void    timers_update(float delta);
+
+/* callback(userptr) once after seconds, it may schedule or cancel timers */
+TimerID timers_after(float seconds, void (*callback)(void *userptr), void *userptr);
+/* does nothing if the timer already ran out or was cancelled */
+void    timers_cancel(TimerID timer);
+size_t  timers_count(void);
+/* 
+ * the scheduled timers and the time, restored in the same process. userptr
+ * is kept as is, timers that outlive a restore should get a handle in it
+ */
+void    timers_snapshot(ArrayBuffer *out);
+void    timers_restore(Span *snapshot);
+
+#endif
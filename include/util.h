@@ -14,13 +14,75 @@ typedef struct ObjectPool ObjectPool;
 typedef struct RelPtr RelPtr;
 typedef struct Allocator Allocator;
 typedef struct FileBuffer FileBuffer;
+typedef struct Arena Arena;
+typedef struct ArenaCheckpoint ArenaCheckpoint;
 
-typedef uint_fast32_t ObjectID;
+/* 
+ * handle to an object inside an ObjectPool: the low bits are the slot index
+ * inside the pool and the high bits a generation, bumped every time the slot
+ * is freed, so an old handle resolves to NULL instead of to whatever was
+ * allocated on the same slot later. 0 is never a valid handle.
+ */
+typedef uint32_t ObjectID;
+
+#define OBJECT_ID_NULL            0
+#define OBJECT_ID_INDEX_BITS      20
+#define OBJECT_ID_INDEX_MASK      ((1u << OBJECT_ID_INDEX_BITS) - 1)
+#define OBJECT_ID_GENERATION_MASK (0xFFFFFFFFu >> OBJECT_ID_INDEX_BITS)
+#define OBJECT_ID_INDEX(ID)       ((ID) & OBJECT_ID_INDEX_MASK)
+#define OBJECT_ID_GENERATION(ID)  ((ID) >> OBJECT_ID_INDEX_BITS)
+
+/* fixes a pointer read back from a snapshot, false if it left it as it was, see objpool_relocate() */
+typedef bool (*Relocator)(void **ptr);
+
+#define ALLOC_TAGS \
+	ALLOC_TAG(PHYSICS)  \
+	ALLOC_TAG(ENTITIES) \
+	ALLOC_TAG(SCENE)    \
+	ALLOC_TAG(UI)       \
+	ALLOC_TAG(AUDIO)    \
+	ALLOC_TAG(MAP)
+
+typedef enum {
+	#define ALLOC_TAG(NAME) ALLOC_TAG_##NAME,
+	ALLOC_TAGS
+	#undef ALLOC_TAG
+	LAST_ALLOC_TAG
+} AllocTag;
+
+typedef struct {
+	size_t resident_bytes, live_bytes, free_bytes;
+	size_t resident_pages, reclaimed_pages;
+} ObjectPoolStats;
+
+typedef struct {
+	size_t live_bytes, peak_bytes;
+	/* frame_allocations is the count of the last finished frame */
+	size_t frame_allocations, total_allocations;
+} AllocStats;
+
+/* 
+ * what an allocator_pending() did since the last alloc_pending_account(), 
+ * only touched by the thread using the allocator
+ */
+typedef struct {
+	AllocTag  tag;
+	ptrdiff_t delta_bytes;
+	int       allocations;
+} PendingAlloc;
 
 struct Allocator {
 	void *userptr;
 	void *(*allocate)(size_t bytes, void *user_ptr);
 	void  (*deallocate)(void *ptr, void *user_ptr);
+
+	/* 
+	 * optional, when NULL alloct_reallocate() does allocate + copy + deallocate 
+	 * and alloct_allocate_aligned() over-allocates through allocate 
+	 */
+	void *(*reallocate)(void *ptr, size_t old_bytes, size_t new_bytes, void *user_ptr);
+	void *(*allocate_aligned)(size_t bytes, size_t alignment, void *user_ptr);
+	void  (*deallocate_aligned)(void *ptr, void *user_ptr);
 };
 
 struct ArrayBuffer {
@@ -42,13 +104,51 @@ struct ObjectPool {
 	ArrayBuffer dirty_buffer;
 	void *object_list;
 
+	/* dense mode: live objects are packed in this array of data pointers
+	 * instead of the linked list, removal is a swap with the last one */
+	bool dense;
+	ArrayBuffer live;
+
+	Allocator allocator;
+
+	/* highest generation handed out before the last reset, new pages start past it */
+	uint32_t generation_seed;
+
+	/* 
+	 * one ObjectPage per entry of pages, a page that stays empty for 
+	 * reclaim_after calls of objpool_clean is given back to the allocator,
+	 * 0 keeps every page until objpool_reset 
+	 */
+	ArrayBuffer page_info;
+	unsigned int reclaim_after;
+	size_t live_count;
+	size_t reclaimed_pages;
+
 	size_t node_size;
 	size_t obj_size;
 	size_t alignment;
 
+	/* the pages that moved on the last objpool_restore(), from where they were to where they are */
+	ArrayBuffer relocations;
+
 	void (*clean_cbk)(ObjectPool *, void*);
 };
 
+/* 
+ * linear allocator, allocating is a pointer bump and freeing is a no-op, 
+ * everything is released at once by arena_reset() or arena_rewind() 
+ */
+struct Arena {
+	ArrayBuffer blocks;
+	size_t block;
+	size_t used;
+};
+
+struct ArenaCheckpoint {
+	size_t block;
+	size_t used;
+};
+
 struct FileBuffer {
 	void *file_handle;
 	ArrayBuffer data_buffer;
@@ -66,8 +166,10 @@ struct RelPtr {
 
 #if defined(__GNUC__)
 	#define ALIGNMENT_OF(X) __alignof__(X)
+	#define PREFETCH(X) __builtin_prefetch(X)
 #elif defined(_MSC_VER)
 	#define ALIGNMENT_OF(X) alignof(X)
+	#define PREFETCH(X) ((void)(X))
 #else
 	#error "No alignment defined!"
 #endif
@@ -101,6 +203,14 @@ void   arrbuf_free(ArrayBuffer *buffer);
 
 void arrbuf_printf(ArrayBuffer *buffer, const char *fmt, ...);
 
+/* appends the length and the contents of buffer to out, arrbuf_restore() reads them back */
+void arrbuf_snapshot(ArrayBuffer *out, ArrayBuffer *buffer);
+void arrbuf_restore(ArrayBuffer *buffer, Span *snapshot);
+
+/* consumes size bytes from the front of the span, dies if it is shorter */
+void *span_take(Span *span, size_t size);
+void  span_read(Span *span, void *data, size_t size);
+
 /* 
  * use only for IN-PLACE STRUCT FILLING, do not save the pointer, 
  * IT WILL become a dangling pointer after a realloc if you are not using 
@@ -125,6 +235,7 @@ StrView strview_token(StrView *str, const char *delim);
 int     strview_cmp(StrView str, const char *str2);
 int     strview_cmpstr(StrView str, StrView str2);
 char   *strview_str(StrView view);
+char   *strview_str_allocator(StrView view, Allocator *allocator);
 void    strview_str_mem(StrView view, char *data, size_t size);
 
 int strview_int(StrView str, int *result);
@@ -142,21 +253,88 @@ void *_erealloc(void *ptr, size_t size, const char *file, int line);
  * use DEFAULT_ALIGNMENT if you don't care about this (which is likely) 
  */
 void objpool_init(ObjectPool *pool, size_t object_size, size_t object_alignment);
+void objpool_init_allocator(ObjectPool *pool, size_t object_size, size_t object_alignment, Allocator allocator);
+/* 
+ * same as objpool_init, but objpool_begin/objpool_next walk a packed array 
+ * instead of the linked list. Objects are never moved, so pointers stay valid,
+ * but the iteration order changes when something is freed.
+ */
+void objpool_init_dense(ObjectPool *pool, size_t object_size, size_t object_alignment, Allocator allocator);
 void objpool_clean(ObjectPool *pool);
 void objpool_reset(ObjectPool *pool);
+void objpool_set_reclaim(ObjectPool *pool, unsigned int idle_cleans);
+ObjectPoolStats objpool_stats(ObjectPool *pool);
 void objpool_terminate(ObjectPool *pool);
+/* 
+ * appends a copy of the pages of the pool to out, after cleaning it. 
+ * objpool_restore() puts it back in the same pool of the same process, the
+ * ObjectIDs are the same as when it was taken but the objects may be at 
+ * other addresses: the links of the pool itself are fixed, the pointers 
+ * inside the objects have to be fixed by the owner with objpool_relocate().
+ * Handles taken after the snapshot may resolve to objects restored on their slot.
+ */
+void objpool_snapshot(ObjectPool *pool, ArrayBuffer *out);
+void objpool_restore(ObjectPool *pool, Span *snapshot);
+/* 
+ * moves a pointer into an object of the pool at the time of the snapshot
+ * restored last to where that object is now. False if it was left as it was:
+ * it didn't point inside the pool or the object is back at the same address.
+ * Only the pages that moved are looked up, a restore into the pages the pool
+ * already had costs nothing here.
+ */
+bool objpool_relocate(ObjectPool *pool, void **ptr);
 
 void *objpool_begin(ObjectPool *pool);
 void *objpool_next(void *data);
+/* only for dense pools, a span of void* that may contain dead objects */
+Span  objpool_live_span(ObjectPool *pool);
 
 void *objpool_new(ObjectPool *pool);
 void  objpool_free(void *object_ptr);
 bool  objpool_is_dead(void *object_ptr);
 
+ObjectID objpool_id(void *object_ptr);
+/* NULL if the handle is stale or the object was already freed */
+void    *objpool_from_id(ObjectPool *pool, ObjectID id);
+
 Allocator allocator_default(void);
+/* heap allocator that keeps the AllocStats of its tag */
+Allocator allocator_tagged(AllocTag tag);
+/* 
+ * heap allocator that doesn't touch the shared counters, so it can be used 
+ * from a job. What it did is added to the tag by alloc_pending_account(), 
+ * called on the main thread after the join
+ */
+Allocator allocator_pending(PendingAlloc *pending);
+void      alloc_pending_account(PendingAlloc *pending);
+
+AllocStats  alloc_tag_stats(AllocTag tag);
+const char *alloc_tag_name(AllocTag tag);
+void        alloc_stats_new_frame(void);
+
+void            arena_init(Arena *arena, size_t initial_size);
+void            arena_terminate(Arena *arena);
+void           *arena_allocate(Arena *arena, size_t size);
+void           *arena_allocate_aligned(Arena *arena, size_t size, size_t alignment);
+/* 
+ * releases everything, if the arena had to grow during the last cycle the 
+ * blocks are merged into a single one, so a steady workload stops touching 
+ * the heap after the first few cycles 
+ */
+void            arena_reset(Arena *arena);
+ArenaCheckpoint arena_checkpoint(Arena *arena);
+void            arena_rewind(Arena *arena, ArenaCheckpoint checkpoint);
+Allocator       arena_allocator(Arena *arena);
+
+/* how many times util went to the heap, for the ZERO_MALLOC checks */
+size_t heap_allocation_count(void);
 
 void *alloct_allocate(Allocator *, size_t size);
 void  alloct_deallocate(Allocator *, void *ptr);
+void *alloct_reallocate(Allocator *, void *ptr, size_t old_size, size_t new_size);
+/* memory from alloct_allocate_aligned() must go back through alloct_deallocate_aligned() */
+void *alloct_allocate_aligned(Allocator *, size_t size, size_t alignment);
+void  alloct_deallocate_aligned(Allocator *, void *ptr);
 
 int  utf8_decode(StrView span);
 void utf8_advance(StrView *span);
@@ -180,5 +358,7 @@ static inline int clampi(int x, int minv, int maxv) {
 }
 
 #define DEFAULT_ALIGNMENT (sizeof(void*))
+/* for objpool_set_reclaim(), around 10 seconds for a pool cleaned every frame */
+#define DEFAULT_RECLAIM_CLEANS 600
 
 #endif
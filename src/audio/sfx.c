@@ -10,7 +10,7 @@ static ObjectPool sfx_sources;
 void
 init_sfx_system(void)
 {
-	objpool_init(&sfx_sources, sizeof(AudioSource), DEFAULT_ALIGNMENT);
+	objpool_init_dense(&sfx_sources, sizeof(AudioSource), DEFAULT_ALIGNMENT, allocator_tagged(ALLOC_TAG_AUDIO));
 }
 
 void
@@ -8,6 +8,7 @@
 #include "util.h"
 
 #include "game_state.h"
+#include "global.h"
 #include "vecmath.h"
 #include "graphics.h"
 #include "map.h"
@@ -763,7 +764,7 @@ mouse_button(SDL_Event *event)
 				rect_begin(event->button.x, event->button.y);
 				mouse_state = MOUSE_DRAWING; 
 			} else {
-				thing = calloc(1, sizeof(*thing));
+				thing = map_new_thing();
 				thing->type = THING_NULL;
 				vec2_dup(thing->position, v);
 				map_insert_thing(editor.map, thing);
@@ -854,7 +855,7 @@ keyboard(SDL_Event *event)
 
 				switch(clipboard) {
 				case CLIPBOARD_THING:
-					new_thing = malloc(sizeof(*new_thing));
+					new_thing = map_new_thing();
 					*new_thing = copied_thing;
 					map_insert_thing(editor.map, new_thing);
 					select_thing(new_thing);
@@ -863,7 +864,7 @@ keyboard(SDL_Event *event)
 				case CLIPBOARD_BRUSH:
 					if(!selected_thing)
 						return;
-					new_brush = malloc(sizeof(*new_brush));
+					new_brush = map_new_brush();
 					*new_brush = copied_brush;
 					
 					map_thing_insert_brush(selected_thing, new_brush);
@@ -919,14 +920,14 @@ keyboard(SDL_Event *event)
 				Thing *thing = selected_thing;
 				map_thing_remove_brush(thing, brush);
 				select_brush(NULL);
-				free(brush);
+				map_del_brush(brush);
 
 				switch(selected_thing->type) {
 				case THING_WORLD_MAP:
 					if(!selected_thing->brush_list) {
 						map_remove_thing(editor.map, thing);
 						select_thing(NULL);
-						free(thing);
+						map_del_thing(thing);
 					}
 				default:
 					break;
@@ -941,9 +942,9 @@ keyboard(SDL_Event *event)
 					brush = next)
 				{
 					next = brush->next;
-					free(brush);
+					map_del_brush(brush);
 				}
-				free(selected_thing);
+				map_del_thing(selected_thing);
 				select_thing(NULL);
 			}
 			break;
@@ -1074,19 +1075,17 @@ loadbtn_load_cbk(UIObject *obj, void *userptr)
 	(void)obj;
 	(void)userptr;
 	StrView path = ui_text_input_get_str(load_path);
+	Allocator scratch = frame_allocator();
 
-	char *fixed_path = strview_str(path);
+	char *fixed_path = strview_str_allocator(path, &scratch);
 	
 	Map *n_map = map_load(fixed_path);
 
-	if(!n_map) {
-		free(fixed_path);
+	if(!n_map)
 		return;
-	}
 
 	map_free(editor.map);
 	editor.map = n_map;
-	free(fixed_path);
 	ui_deparent(load_window);
 	ui_text_input_clear(load_path);
 }
@@ -1097,14 +1096,14 @@ save_btn_cbk(UIObject *obj, void *userptr)
 	(void)obj;
 	(void)userptr;
 	StrView path = ui_text_input_get_str(save_path);
+	Allocator scratch = frame_allocator();
 
-	char *fixed_path = strview_str(path);
+	char *fixed_path = strview_str_allocator(path, &scratch);
 
 	if(export_map(fixed_path)) {
 		ui_deparent(save_window);
 		ui_text_input_clear(save_path);
 	}
-	free(fixed_path);
 }
 
 void
@@ -1239,7 +1238,7 @@ void
 rect_begin(int x, int y)
 {
 	if(!selected_thing) {
-		Thing *thing = calloc(1, sizeof(*selected_thing));
+		Thing *thing = map_new_thing();
 		thing->type = THING_WORLD_MAP;
 		map_insert_thing(editor.map, thing);
 		select_thing(thing);
@@ -1260,7 +1259,7 @@ rect_begin(int x, int y)
 		if(!selected_brush)
 			return;
 	} else {
-		MapBrush *brush = calloc(1, sizeof(MapBrush));
+		MapBrush *brush = map_new_brush();
 		brush->half_size[0] = 0;
 		brush->half_size[1] = 0;
 		brush->tile = editor.current_tile;
@@ -1308,7 +1307,7 @@ rect_end(int x, int y)
 
 	if(selected_brush->half_size[0] < 1.0 / 64.0 || selected_brush->half_size[1] < 1.0 / 64.0) {
 		map_thing_remove_brush(selected_thing, selected_brush);
-		free(selected_brush);
+		map_del_brush(selected_brush);
 		selected_brush = NULL;
 	}
 }
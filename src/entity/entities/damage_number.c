@@ -9,20 +9,21 @@
 
 #define SELF      ENT_DATA(ENTITY_DAMAGE_NUMBER, self)
 
-static void damage_number_update(Entity *self, float delta);
-static void damage_number_die(Entity *self);
 
 static EntityInterface dn_interface = {
-	.update = damage_number_update,
-	.die = damage_number_die
+	.update = ent_damage_number_update,
+	.parallel_update = true,
+	.tick = TICK_NEAR_VIEW,
 };
 
 DamageNumber * 
 ent_damage_number(vec2 position, float damage)
 {
 	(void)damage;
-	DamageNumber *self = (DamageNumber*)ent_new(ENTITY_DAMAGE_NUMBER, &dn_interface);
+	Entity *entity = ent_new(ENTITY_DAMAGE_NUMBER, &dn_interface);
+	DamageNumber *self = &entity->damage_number;
 	self->text = gfx_scene_new_obj(1, SCENE_OBJECT_TEXT);
+	ent_bind_sprite(entity, self->text, self->text->position, NULL);
 
 	vec2_dup(self->position, position);
 
@@ -35,20 +36,17 @@ ent_damage_number(vec2 position, float damage)
 
 	self->time = 0.0; 
 	self->max_time = 3.0;
+	ent_set_lifetime(entity, self->max_time);
 	return self;
 }
 
 void
-damage_number_update(Entity *ent, float delta) 
+ent_damage_number_update(Entity *ent, float delta) 
 {
 	vec2 position;
 	DamageNumber *self = &ent->damage_number;
 
 	self->time += delta;
-	if(self->time > self->max_time) {
-		ent_del((Entity*)self);
-		return;
-	}
 	float clamped_time = fmin(self->time / self->max_time, 1.0);
 
 	position[0] = clamped_time;
@@ -58,9 +56,3 @@ damage_number_update(Entity *ent, float delta)
 	vec2_add(position, position, self->position);
 	vec2_dup(self->text->position, position);
 }
-
-void
-damage_number_die(Entity* self) 
-{
-	gfx_scene_del_obj((SceneObject*)self->damage_number.text);
-}
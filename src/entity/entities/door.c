@@ -14,16 +14,16 @@
 
 #define EPSLON 0.001
 #define DRAG 100
+/* openness and speed under this from the target, the door stops swinging and sleeps */
+#define SLEEP_EPSILON 0.01
 
 static Rectangle door_hover_rect(Entity *);
-static void door_update(Entity *, float);
-static void door_die(Entity *);
 static bool door_mouse_hovered(Entity *, vec2 mouse_pos);
 static void door_mouse_interact(Entity *, Player *, vec2 mouse_pos);
 
 static EntityInterface door_int = {
-	.die = door_die,
-	.update = door_update,
+	.update = ent_door_update,
+	.tick = TICK_ON_WAKE,
 	.mouse_hovered = door_mouse_hovered,
 	.mouse_interact = door_mouse_interact
 };
@@ -31,7 +31,8 @@ static EntityInterface door_int = {
 Door *
 ent_door_new(vec2 position, Direction direction)
 {
-	Door *door = &ent_new(ENTITY_DOOR, &door_int)->door;
+	Entity *entity = ent_new(ENTITY_DOOR, &door_int);
+	Door *door = &entity->door;
 
 	door->openness = 0;
 	door->openness_speed = 0;
@@ -45,16 +46,18 @@ ent_door_new(vec2 position, Direction direction)
 	door->line->color[2] = 0.149;
 	door->line->color[3] = 1.000;
 	door->line->thickness = ENTITY_SCALE / 8;
+	ent_bind_sprite(entity, door->line, door->line->p1, NULL);
 
 	door->body = phx_new();
-	vec2_dup(door->body->position, position);
+	vec2_dup(phx_position(door->body), position);
 	door->body->half_size[0] = ENTITY_SCALE / 8;
 	door->body->half_size[1] = ENTITY_SCALE * 2;
 	door->body->is_static = true;
 	door->body->no_update = true;
 	door->body->collision_layer = PHX_LAYER_ENTITIES_BIT;
 	door->body->solve_layer = PHX_LAYER_ENTITIES_BIT;
-	door->body->entity = (Entity*)door;
+	ent_bind_body(entity, door->body);
+	ent_wake(entity);
 
 	switch(direction) {
 	case DIR_RIGHT:
@@ -96,6 +99,7 @@ ent_door_open(Door *door)
 	if(!door->open) {
 		door->open = true;
 		door->body->active = 0;
+		ent_wake((Entity*)door);
 		audio_sfx_play(AUDIO_MIXER_SFX, AUDIO_BUFFER_DOOR_OPEN, 1.0);
 	}
 }
@@ -106,6 +110,7 @@ ent_door_close(Door *door)
 	if(door->open) {
 		door->open = false;
 		door->body->active = 1;
+		ent_wake((Entity*)door);
 		audio_sfx_play(AUDIO_MIXER_SFX, AUDIO_BUFFER_DOOR_CLOSE, 1.0);
 	}
 }
@@ -117,7 +122,7 @@ ent_door_is_open(Door *door)
 }
 
 void
-door_update(Entity *door_ent, float delta)
+ent_door_update(Entity *door_ent, float delta)
 {
 	Door *door = &door_ent->door;
 	
@@ -134,18 +139,16 @@ door_update(Entity *door_ent, float delta)
 		door->openness_speed = 0.0;
 		door->openness = 0.0;
 	}
+	if(fabsf((float)door->open - door->openness) < SLEEP_EPSILON && fabsf(door->openness_speed) < SLEEP_EPSILON) {
+		door->openness_speed = 0.0;
+		door->openness = door->open;
+		ent_sleep(door_ent);
+	}
 
 	door->line->p2[0] = sinf(door->openness * M_PI * 0.5 + door->door_angle) * ENTITY_SCALE * 4.0 + door->line->p1[0];
 	door->line->p2[1] = cosf(door->openness * M_PI * 0.5 + door->door_angle) * ENTITY_SCALE * 4.0 + door->line->p1[1];
 }
 
-void
-door_die(Entity *door_ent)
-{
-	gfx_scene_del_obj(door_ent->door.line);
-	phx_del(door_ent->door.body);
-}
-
 bool 
 door_mouse_hovered(Entity *door_ent, vec2 mouse_pos)
 {
@@ -159,7 +162,7 @@ door_hover_rect(Entity *door_ent)
 	Door *door = &door_ent->door;
 	Rectangle rect;
 
-	vec2_dup(rect.position, door->body->position);
+	vec2_dup(rect.position, phx_position(door->body));
 	switch(door->direction) {
 	case DIR_RIGHT:
 		rect.half_size[0] = ENTITY_SCALE;
@@ -11,12 +11,11 @@
 
 #define SPEED 50
 
-static void player_update(Entity *player, float delta);
 static void player_take_damage(Entity *player, float damage);
 static void player_die(Entity *player);
 
 static EntityInterface player_interface = {
-	.update = player_update,
+	.update = ent_player_update,
 	.take_damage = player_take_damage,
 	.die = player_die
 };
@@ -24,20 +23,23 @@ static EntityInterface player_interface = {
 Player *
 ent_player_new(vec2 position)
 {
-	Player *self = (Player*)&ent_new(ENTITY_PLAYER, &player_interface)->player;
+	Entity *entity = ent_new(ENTITY_PLAYER, &player_interface);
+	Player *self = &entity->player;
 	
 	self->body = phx_new();
 	self->sprite = gfx_scene_new_obj(1, SCENE_OBJECT_ANIMATED_SPRITE);
-	vec2_dup(self->body->position, position);
+	vec2_dup(phx_position(self->body), position);
 	vec2_dup(self->body->half_size, (vec2){ ENTITY_SCALE, ENTITY_SCALE });
-	vec2_dup(self->body->velocity, (vec2){ 0.0, 0.0 });
+	vec2_dup(phx_velocity(self->body), (vec2){ 0.0, 0.0 });
 	self->body->is_static = false;
+	self->body->solve_layer     = PHX_LAYER_ENTITIES_BIT;
+	self->body->solve_mask      = PHX_LAYER_ENTITIES_BIT | PHX_LAYER_MAP_BIT;
 	self->body->collision_layer = PHX_LAYER_ENTITIES_BIT;
 	self->body->collision_mask  = PHX_LAYER_ENTITIES_BIT | PHX_LAYER_MAP_BIT;
-	self->body->entity = (Entity*)self;
+	ent_bind_body(entity, self->body);
 	self->body->mass = 10.0;
 	self->body->restitution = 0.01;
-	self->body->damping = 5.0;
+	phx_set_damping(self->body, 5.0);
 
 	vec2_dup(self->sprite->position, position);
 	vec2_dup(self->sprite->half_size, (vec2){ ENTITY_SCALE, ENTITY_SCALE });
@@ -46,10 +48,10 @@ ent_player_new(vec2 position)
 	self->sprite->fps = 0.0;
 	self->sprite->time = 0.0;
 	self->sprite->animation = ANIMATION_PLAYER_IDLE;
+	ent_bind_sprite(entity, self->sprite, self->sprite->position, self->body);
 	self->fired = 0;
 
-	self->mob.health = 10;
-	self->mob.health_max = 10;
+	ent_add_mob(entity, 10);
 	self->moving = false;
 
 	EVENT_EMIT(EVENT_PLAYER_SPAWN, .player = (Entity*)self);
@@ -58,7 +60,7 @@ ent_player_new(vec2 position)
 }
 
 void
-player_update(Entity *self_player, float delta) 
+ent_player_update(Entity *self_player, float delta) 
 {
 	(void)delta;
 	int mouse_x, mouse_y;
@@ -70,21 +72,21 @@ player_update(Entity *self_player, float delta)
 
 	self->moving = false;
 	if(keys[SDL_SCANCODE_W]) {
-		self->body->accel[1] -= SPEED;
+		phx_accel(self->body)[1] -= SPEED;
 		self->moving = true;
 	}
 	if(keys[SDL_SCANCODE_S]) {
-		self->body->accel[1] += SPEED;
+		phx_accel(self->body)[1] += SPEED;
 		self->moving = true;
 	}
 	if(keys[SDL_SCANCODE_A]) {
 		self->sprite->half_size[0] = -ENTITY_SCALE;
-		self->body->accel[0] -= SPEED;
+		phx_accel(self->body)[0] -= SPEED;
 		self->moving = true;
 	}
 	if(keys[SDL_SCANCODE_D]) {
 		self->sprite->half_size[0] = ENTITY_SCALE;
-		self->body->accel[0] += SPEED;
+		phx_accel(self->body)[0] += SPEED;
 		self->moving = true;
 	}
 
@@ -106,10 +108,10 @@ player_update(Entity *self_player, float delta)
 			mouse_pos[0] = mouse_x, mouse_pos[1] = mouse_y;
 
 			gfx_pixel_to_world(mouse_pos, mouse_pos);
-			vec2_sub(mouse_pos, mouse_pos, self->body->position);
+			vec2_sub(mouse_pos, mouse_pos, phx_position(self->body));
 			vec2_normalize(mouse_pos, mouse_pos);
 			vec2_mul(mouse_pos, mouse_pos, (vec2){ 40.0, 40.0 });
-			ent_fireball_new(self_player, VEC2_DUP(self->body->position), mouse_pos);
+			ent_fireball_new(self_player, VEC2_DUP(phx_position(self->body)), mouse_pos);
 			self->fired += 1;
 
 			audio_sfx_play(AUDIO_MIXER_SFX, AUDIO_BUFFER_FIREBALL, 1.0);
@@ -117,22 +119,17 @@ player_update(Entity *self_player, float delta)
 	} else {
 		self->fired = 0;
 	}
-	vec2_dup(self->sprite->position, self->body->position);
-	mob_process(self_player, &self->mob);
 }
 
 void
 player_take_damage(Entity *self, float health)
 {
-	self->player.mob.health += health;
+	ent_mob(self)->health += health;
 }
 
 void
 player_die(Entity *self_id) 
 {
-	Player *pl = &self_id->player;
-	gfx_scene_del_obj(pl->sprite);
-	phx_del(pl->body);
-
+	(void)self_id;
 	GLOBAL.player = NULL;
 }
@@ -1,62 +1,373 @@
 #include <SDL.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <stddef.h>
+#include <string.h>
 
 #include "physics.h"
+#include "jobs.h"
+#include "timers.h"
 #include "util.h"
 #include "vecmath.h"
 #include "entity.h"
+#include "fns.h"
 
 #define MAX_INTERACT_DIST (10 * ENTITY_SCALE)
+/* 
+ * how far from its body an entity may draw its hover area, an open door 
+ * is hovered two ENTITY_SCALEs off its body 
+ */
+#define MAX_HOVER_REACH   (4 * ENTITY_SCALE)
+#define MAX_HOVER_BODIES  64
 
+/* 
+ * an entity's ObjectID is the one of its type pool with the type in the top
+ * bits of the index, so a type has room for 1 << ENTITY_ID_TYPE_SHIFT entities
+ */
+#define ENTITY_ID_TYPE_SHIFT 17
+#define ENTITY_ID_TYPE_MASK  (((1u << OBJECT_ID_INDEX_BITS) - 1) & ~((1u << ENTITY_ID_TYPE_SHIFT) - 1))
+
+/* the data of a deferred command follows it, padded to COMMAND_ALIGNMENT */
+#define COMMAND_ALIGNMENT 16
+/* 
+ * a parallel update splits a type in at most UPDATE_CHUNKS chunks of at 
+ * least UPDATE_CHUNK_MIN entities, the split depends only on the count so 
+ * the queued commands come out in the same order with any number of workers
+ */
+#define UPDATE_CHUNKS    64
+#define UPDATE_CHUNK_MIN 256
+/* a TICK_NEAR_VIEW entity further than TICK_NEAR_MARGIN out of the view ticks at TICK_FAR_RATE */
+#define TICK_NEAR_MARGIN (8 * ENTITY_SCALE)
+#define TICK_FAR_RATE    4.0f
+
+/* 
+ * each type has its own pool, sized for its member of the union only, 
+ * data is the last field and a pool's objects end after that member
+ */
 typedef struct {
 	EntityType type;
 	EntityInterface *interface;
+	unsigned int components[COMPONENT_COUNT];
+	/* ent_del() was called, it is freed on the next ent_flush() */
+	bool dying;
+	/* a TICK_ON_WAKE entity only updates while set */
+	bool awake;
+	/* time since the last update, passed to it as delta */
+	float tick_delta;
 	Entity data;
 } EntityObject;
 
-static ObjectPool objects;
+typedef struct {
+	void (*run)(void *data);
+	size_t size;
+} Command;
+
+typedef struct {
+	vec2 position;
+	float damage;
+} DamageNumberCommand;
+
+typedef struct {
+	ObjectID target;
+	float damage;
+	vec2 position;
+} DamageCommand;
+
+typedef struct {
+	EntityType type;
+	EntityObject **objects;
+	size_t count;
+	int chunk_count;
+	float delta;
+} UpdateJob;
+
+static void update_serial(EntityType type, float delta);
+static void update_parallel(EntityType type, float delta);
+static void update_chunk(int index, void *userptr);
+static bool due_tick(EntityObject *obj, float delta, EntityTickStats *stats);
+static ArrayBuffer *command_queue(void);
+static void flush_destroys(void);
+static void spawn_damage_number(void *data);
+static void delete_entity(void *data);
+static void take_damage(void *data);
+static void relocate_entities(void);
+
+static ObjectPool objects[LAST_ENTITY];
+/* queued by ent_defer() and ent_del(), the deletes are kept per type pool */
+static ArrayBuffer commands, running;
+static ArrayBuffer destroys[LAST_ENTITY];
+/* 
+ * commands queued by each chunk of a parallel update, appended in chunk order.
+ * They grow on the workers, so their memory is accounted after the join
+ */
+static ArrayBuffer chunk_commands[UPDATE_CHUNKS];
+static PendingAlloc chunk_allocs[UPDATE_CHUNKS];
+/* the chunk queue of the running thread, unset outside of a parallel update */
+static SDL_TLSID chunk_queue;
+/* what the deleted entities owned, freed a pool at a time */
+static ArrayBuffer dead_bodies, dead_objects;
+/* entities of each type with an update or render callback, the loops skip a type without any */
+static size_t updating[LAST_ENTITY];
+static size_t rendering[LAST_ENTITY];
+/* the ones whose update is parallel_update, the type runs in chunks when all of them are */
+static size_t parallel_updating[LAST_ENTITY];
+/* the view grown by TICK_NEAR_MARGIN, has_view is false until ent_set_view() */
+static Rectangle near_view;
+static bool has_view;
+static EntityTickStats tick_stats;
+static EntityTickStats chunk_stats[UPDATE_CHUNKS];
+
+static const size_t entity_sizes[LAST_ENTITY] = {
+	#define MAC_ENTITY(NAME) [NAME] = sizeof(struct NAME##_struct),
+		ENTITY_LIST
+	#undef MAC_ENTITY
+};
+
+#if defined(ENT_STATIC_DISPATCH) && !defined(NDEBUG)
+/* only to check the interfaces against ENTITY_UPDATE_LIST */
+static void (*const static_updates[LAST_ENTITY])(Entity *, float) = {
+	#define MAC_ENTITY_UPDATE(TYPE, FUNCTION) [TYPE] = FUNCTION,
+		ENTITY_UPDATE_LIST
+	#undef MAC_ENTITY_UPDATE
+};
+#endif
 
 void
 ent_init(void)
 {
-	objpool_init(&objects, sizeof(EntityObject), DEFAULT_ALIGNMENT);
+	assert(LAST_ENTITY <= 1 << (OBJECT_ID_INDEX_BITS - ENTITY_ID_TYPE_SHIFT));
+	for(EntityType type = ENTITY_NULL + 1; type < LAST_ENTITY; type++) {
+		objpool_init_dense(&objects[type], offsetof(EntityObject, data) + entity_sizes[type], 
+			DEFAULT_ALIGNMENT, allocator_tagged(ALLOC_TAG_ENTITIES));
+		objpool_set_reclaim(&objects[type], DEFAULT_RECLAIM_CLEANS);
+		arrbuf_init_allocator(&destroys[type], allocator_tagged(ALLOC_TAG_ENTITIES));
+	}
+	arrbuf_init_allocator(&commands, allocator_tagged(ALLOC_TAG_ENTITIES));
+	arrbuf_init_allocator(&running, allocator_tagged(ALLOC_TAG_ENTITIES));
+	for(int i = 0; i < UPDATE_CHUNKS; i++) {
+		chunk_allocs[i] = (PendingAlloc){ .tag = ALLOC_TAG_ENTITIES };
+		arrbuf_init_allocator(&chunk_commands[i], allocator_pending(&chunk_allocs[i]));
+		alloc_pending_account(&chunk_allocs[i]);
+	}
+	chunk_queue = SDL_TLSCreate();
+	arrbuf_init_allocator(&dead_bodies, allocator_tagged(ALLOC_TAG_ENTITIES));
+	arrbuf_init_allocator(&dead_objects, allocator_tagged(ALLOC_TAG_ENTITIES));
+	ent_components_init();
+	ent_particles_init();
 }
 
 void
 ent_end(void)
 {
-	objpool_terminate(&objects);
+	for(EntityType type = ENTITY_NULL + 1; type < LAST_ENTITY; type++) {
+		objpool_terminate(&objects[type]);
+		arrbuf_free(&destroys[type]);
+	}
+	arrbuf_free(&commands);
+	arrbuf_free(&running);
+	for(int i = 0; i < UPDATE_CHUNKS; i++) {
+		arrbuf_free(&chunk_commands[i]);
+		alloc_pending_account(&chunk_allocs[i]);
+	}
+	arrbuf_free(&dead_bodies);
+	arrbuf_free(&dead_objects);
+	ent_components_end();
+	ent_particles_end();
 }
 
 void
 ent_reset(void)
 {
-	objpool_reset(&objects);
+	for(EntityType type = ENTITY_NULL + 1; type < LAST_ENTITY; type++) {
+		objpool_reset(&objects[type]);
+		arrbuf_clear(&destroys[type]);
+		updating[type] = 0;
+		rendering[type] = 0;
+		parallel_updating[type] = 0;
+	}
+	has_view = false;
+	arrbuf_clear(&commands);
+	ent_components_reset();
+	ent_particles_reset();
 }
 
 void
 ent_update(float delta)
 {
-	for(EntityObject * obj = objpool_begin(&objects);
+	tick_stats = (EntityTickStats){ 0 };
+	/* a type at a time, so the same update runs over a packed array */
+	for(EntityType type = ENTITY_NULL + 1; type < LAST_ENTITY; type++) {
+		if(!updating[type])
+			continue;
+		if(parallel_updating[type] == updating[type])
+			update_parallel(type, delta);
+		else
+			update_serial(type, delta);
+	}
+	ent_components_update(delta);
+	ent_particles_update(delta);
+
+	ent_flush();
+	ent_components_clean();
+	for(EntityType type = ENTITY_NULL + 1; type < LAST_ENTITY; type++)
+		objpool_clean(&objects[type]);
+}
+
+void
+update_serial(EntityType type, float delta)
+{
+#ifdef ENT_STATIC_DISPATCH
+	switch(type) {
+	#define MAC_ENTITY_UPDATE(TYPE, FUNCTION)                    \
+	case TYPE:                                                   \
+		for(EntityObject *obj = objpool_begin(&objects[TYPE]);   \
+			obj;                                                 \
+			obj = objpool_next(obj))                             \
+		{                                                        \
+			if(due_tick(obj, delta, &tick_stats)) {              \
+				FUNCTION(&obj->data, obj->tick_delta);           \
+				obj->tick_delta = 0.0f;                          \
+			}                                                    \
+		}                                                        \
+		return;
+		ENTITY_UPDATE_LIST
+	#undef MAC_ENTITY_UPDATE
+	default:
+		break;
+	}
+#endif
+	for(EntityObject *obj = objpool_begin(&objects[type]);
 		obj;
 		obj = objpool_next(obj))
 	{
-		if(obj->interface->update)
-			obj->interface->update(&obj->data, delta);
+		if(obj->interface->update && due_tick(obj, delta, &tick_stats)) {
+			obj->interface->update(&obj->data, obj->tick_delta);
+			obj->tick_delta = 0.0f;
+		}
+	}
+}
+
+void
+update_parallel(EntityType type, float delta)
+{
+	Span live = objpool_live_span(&objects[type]);
+	UpdateJob job = {
+		.type    = type,
+		.objects = live.begin,
+		.count   = (EntityObject**)live.end - (EntityObject**)live.begin,
+		.delta   = delta,
+	};
+
+	job.chunk_count = clampi(job.count / UPDATE_CHUNK_MIN, 1, UPDATE_CHUNKS);
+	jobs_parallel_for(job.chunk_count, update_chunk, &job);
+
+	for(int i = 0; i < job.chunk_count; i++) {
+		tick_stats.ticked  += chunk_stats[i].ticked;
+		tick_stats.skipped += chunk_stats[i].skipped;
+		alloc_pending_account(&chunk_allocs[i]);
+		if(!chunk_commands[i].size)
+			continue;
+		memcpy(arrbuf_newptr(&commands, chunk_commands[i].size), chunk_commands[i].data, chunk_commands[i].size);
+		arrbuf_clear(&chunk_commands[i]);
 	}
-	objpool_clean(&objects);
+}
+
+void
+update_chunk(int index, void *userptr)
+{
+	UpdateJob *job = userptr;
+	size_t begin = job->count * index / job->chunk_count;
+	size_t end   = job->count * (index + 1) / job->chunk_count;
+	EntityTickStats *stats = &chunk_stats[index];
+
+	*stats = (EntityTickStats){ 0 };
+	SDL_TLSSet(chunk_queue, &chunk_commands[index], NULL);
+#ifdef ENT_STATIC_DISPATCH
+	switch(job->type) {
+	#define MAC_ENTITY_UPDATE(TYPE, FUNCTION)                    \
+	case TYPE:                                                   \
+		for(size_t i = begin; i < end; i++) {                    \
+			EntityObject *obj = job->objects[i];                 \
+			if(!objpool_is_dead(obj)                             \
+				&& due_tick(obj, job->delta, stats))             \
+			{                                                    \
+				FUNCTION(&obj->data, obj->tick_delta);           \
+				obj->tick_delta = 0.0f;                          \
+			}                                                    \
+		}                                                        \
+		SDL_TLSSet(chunk_queue, NULL, NULL);                     \
+		return;
+		ENTITY_UPDATE_LIST
+	#undef MAC_ENTITY_UPDATE
+	default:
+		break;
+	}
+#endif
+	for(size_t i = begin; i < end; i++) {
+		EntityObject *obj = job->objects[i];
+
+		if(!objpool_is_dead(obj) && obj->interface->update && due_tick(obj, job->delta, stats)) {
+			obj->interface->update(&obj->data, obj->tick_delta);
+			obj->tick_delta = 0.0f;
+		}
+	}
+	SDL_TLSSet(chunk_queue, NULL, NULL);
+}
+
+bool
+due_tick(EntityObject *obj, float delta, EntityTickStats *stats)
+{
+	bool due = true;
+	vec2 position;
+
+	if(obj->dying)
+		return false;
+	obj->tick_delta += delta;
+	switch(obj->interface->tick) {
+	case TICK_EVERY_FRAME:
+		break;
+	case TICK_RATE:
+		due = obj->tick_delta * obj->interface->tick_rate >= 1.0f;
+		break;
+	case TICK_NEAR_VIEW:
+		due = !has_view
+			|| obj->tick_delta * TICK_FAR_RATE >= 1.0f
+			|| !ent_components_position(&obj->data, position)
+			|| rect_contains_point(&near_view, position);
+		break;
+	case TICK_ON_WAKE:
+		due = obj->awake;
+		/* asleep time is not passed to the next update */
+		if(!due)
+			obj->tick_delta = 0.0f;
+		break;
+	}
+	stats->ticked  += due;
+	stats->skipped += !due;
+	return due;
+}
+
+ArrayBuffer *
+command_queue(void)
+{
+	ArrayBuffer *queue = SDL_TLSGet(chunk_queue);
+	return queue ? queue : &commands;
 }
 
 void
 ent_render(void)
 {
-	for(EntityObject *object = objpool_begin(&objects);
-		object;
-		object = objpool_next(object))
-	{
-		if(object->interface->render)
-			object->interface->render(&object->data);
+	ent_components_render();
+	for(EntityType type = ENTITY_NULL + 1; type < LAST_ENTITY; type++) {
+		if(!rendering[type])
+			continue;
+		for(EntityObject *object = objpool_begin(&objects[type]);
+			object;
+			object = objpool_next(object))
+		{
+			if(object->interface->render)
+				object->interface->render(&object->data);
+		}
 	}
 }
 
@@ -64,10 +375,24 @@ Entity *
 ent_new(EntityType type, EntityInterface *interface)
 {
 	assert(interface != NULL);
+	assert(type > ENTITY_NULL && type < LAST_ENTITY);
+#if defined(ENT_STATIC_DISPATCH) && !defined(NDEBUG)
+	assert(!static_updates[type] || interface->update == static_updates[type]);
+#endif
 
-	EntityObject *object = objpool_new(&objects);
+	EntityObject *object = objpool_new(&objects[type]);
+	assert(OBJECT_ID_INDEX(objpool_id(object)) < (1u << ENTITY_ID_TYPE_SHIFT));
+
+	memset(object->components, 0, sizeof(object->components));
+	memset(&object->data, 0, entity_sizes[type]);
+	object->dying = false;
+	object->awake = false;
+	object->tick_delta = 0.0f;
 	object->type = type;
 	object->interface = interface;
+	updating[type]  += interface->update != NULL;
+	rendering[type] += interface->render != NULL;
+	parallel_updating[type] += interface->update && interface->parallel_update;
 	return &object->data;
 }
 
@@ -75,9 +400,170 @@ void
 ent_del(Entity *e)
 {
 	EntityObject *obj = CONTAINER_OF(e, EntityObject, data);
-	if(obj->interface->die)
-		obj->interface->die(e);
-	objpool_free(obj);
+
+	if(SDL_TLSGet(chunk_queue)) {
+		ent_defer(delete_entity, &e, sizeof(e));
+		return;
+	}
+	/* a fireball may hit two bodies on the same step */
+	if(obj->dying)
+		return;
+	obj->dying = true;
+	ent_components_disable(e);
+	arrbuf_insert(&destroys[obj->type], sizeof(EntityObject*), &obj);
+}
+
+void
+ent_defer(void (*run)(void *data), void *data, size_t size)
+{
+	size_t padded = (size + COMMAND_ALIGNMENT - 1) / COMMAND_ALIGNMENT * COMMAND_ALIGNMENT;
+	Command *command = arrbuf_newptr(command_queue(), sizeof(Command) + padded);
+
+	command->run  = run;
+	command->size = padded;
+	memcpy(command + 1, data, size);
+}
+
+void
+ent_flush(void)
+{
+	/* 
+	 * commands and die callbacks may queue more of both, flush_destroys()
+	 * leaves no deletes pending but a die may have queued commands
+	 */
+	do {
+		/* swapped so the ones queued while running go to the other buffer */
+		ArrayBuffer swap = running;
+		running  = commands;
+		commands = swap;
+
+		for(size_t offset = 0; offset < running.size;) {
+			Command *command = (Command*)((char*)running.data + offset);
+			command->run(command + 1);
+			offset += sizeof(Command) + command->size;
+		}
+		arrbuf_clear(&running);
+		flush_destroys();
+	} while(commands.size);
+}
+
+void
+flush_destroys(void)
+{
+	size_t done[LAST_ENTITY] = { 0 };
+	bool added;
+
+	/* die may delete others of any type, so again until none was added */
+	do {
+		added = false;
+		for(EntityType type = ENTITY_NULL + 1; type < LAST_ENTITY; type++) {
+			for(; done[type] < arrbuf_length(&destroys[type], sizeof(EntityObject*)); done[type]++) {
+				EntityObject *obj = ((EntityObject**)destroys[type].data)[done[type]];
+
+				if(obj->interface->die)
+					obj->interface->die(&obj->data);
+				ent_components_del(&obj->data, &dead_bodies, &dead_objects);
+				updating[obj->type]  -= obj->interface->update != NULL;
+				rendering[obj->type] -= obj->interface->render != NULL;
+				parallel_updating[obj->type] -= obj->interface->update && obj->interface->parallel_update;
+				added = true;
+			}
+		}
+	} while(added);
+
+	Span bodies = arrbuf_span(&dead_bodies);
+	SPAN_FOR(bodies, body, Body*) {
+		phx_del(*body);
+	}
+	Span scene_objects = arrbuf_span(&dead_objects);
+	SPAN_FOR(scene_objects, object, SceneObject*) {
+		gfx_scene_del_obj(*object);
+	}
+	for(EntityType type = ENTITY_NULL + 1; type < LAST_ENTITY; type++) {
+		Span dead = arrbuf_span(&destroys[type]);
+		SPAN_FOR(dead, obj, EntityObject*) {
+			objpool_free(*obj);
+		}
+		arrbuf_clear(&destroys[type]);
+	}
+	arrbuf_clear(&dead_bodies);
+	arrbuf_clear(&dead_objects);
+}
+
+void
+ent_snapshot(ArrayBuffer *out)
+{
+	ent_flush();
+	ent_components_clean();
+	arrbuf_clear(out);
+	for(EntityType type = ENTITY_NULL + 1; type < LAST_ENTITY; type++)
+		objpool_snapshot(&objects[type], out);
+	arrbuf_insert(out, sizeof(updating), updating);
+	arrbuf_insert(out, sizeof(rendering), rendering);
+	arrbuf_insert(out, sizeof(parallel_updating), parallel_updating);
+	phx_snapshot(out);
+	gfx_scene_snapshot(out);
+	timers_snapshot(out);
+	ent_components_snapshot(out);
+	ent_particles_snapshot(out);
+}
+
+void
+ent_restore(ArrayBuffer *snapshot)
+{
+	Span reader = arrbuf_span(snapshot);
+
+	/* what was queued belongs to the world being replaced */
+	arrbuf_clear(&commands);
+	arrbuf_clear(&dead_bodies);
+	arrbuf_clear(&dead_objects);
+	for(EntityType type = ENTITY_NULL + 1; type < LAST_ENTITY; type++) {
+		arrbuf_clear(&destroys[type]);
+		objpool_restore(&objects[type], &reader);
+	}
+	span_read(&reader, updating, sizeof(updating));
+	span_read(&reader, rendering, sizeof(rendering));
+	span_read(&reader, parallel_updating, sizeof(parallel_updating));
+	/* the others point to the entities, so these go first */
+	phx_restore(&reader, ent_relocate);
+	gfx_scene_restore(&reader, ent_relocate);
+	timers_restore(&reader);
+	ent_components_restore(&reader);
+	ent_particles_restore(&reader);
+	assert(reader.begin == reader.end && "ent_restore() of a snapshot of another build");
+	relocate_entities();
+}
+
+bool
+ent_relocate(void **ptr)
+{
+	for(EntityType type = ENTITY_NULL + 1; type < LAST_ENTITY; type++) {
+		if(objpool_relocate(&objects[type], ptr))
+			return true;
+	}
+	return false;
+}
+
+void
+relocate_entities(void)
+{
+	#define MAC_ENTITY_POINTER(TYPE, FIELD, RELOCATE)            \
+		for(EntityObject *obj = objpool_begin(&objects[TYPE]);   \
+			obj;                                                 \
+			obj = objpool_next(obj))                             \
+		{                                                        \
+			RELOCATE((void**)&obj->data.FIELD);                  \
+		}
+		ENTITY_POINTER_LIST
+	#undef MAC_ENTITY_POINTER
+}
+
+void
+ent_expire(Entity *e)
+{
+	EntityObject *obj = CONTAINER_OF(e, EntityObject, data);
+	if(obj->interface->expire)
+		obj->interface->expire(e);
 }
 
 EntityType
@@ -86,6 +572,76 @@ ent_type(Entity *e)
 	return CONTAINER_OF(e, EntityObject, data)->type;
 }
 
+ObjectID
+ent_id(Entity *e)
+{
+	EntityObject *obj = CONTAINER_OF(e, EntityObject, data);
+	return objpool_id(obj) | ((ObjectID)obj->type << ENTITY_ID_TYPE_SHIFT);
+}
+
+Entity *
+ent_from_id(ObjectID id)
+{
+	EntityType type = (id & ENTITY_ID_TYPE_MASK) >> ENTITY_ID_TYPE_SHIFT;
+	EntityObject *obj;
+
+	if(type <= ENTITY_NULL || type >= LAST_ENTITY)
+		return NULL;
+	obj = objpool_from_id(&objects[type], id & ~ENTITY_ID_TYPE_MASK);
+	return obj && !obj->dying ? &obj->data : NULL;
+}
+
+unsigned int *
+ent_component_slots(Entity *e)
+{
+	return CONTAINER_OF(e, EntityObject, data)->components;
+}
+
+void
+ent_set_view(Rectangle *view)
+{
+	has_view = view != NULL;
+	if(!view)
+		return;
+	vec2_dup(near_view.position, view->position);
+	vec2_add(near_view.half_size, view->half_size, (vec2){ TICK_NEAR_MARGIN, TICK_NEAR_MARGIN });
+}
+
+void
+ent_wake(Entity *e)
+{
+	CONTAINER_OF(e, EntityObject, data)->awake = true;
+}
+
+void
+ent_sleep(Entity *e)
+{
+	CONTAINER_OF(e, EntityObject, data)->awake = false;
+}
+
+EntityTickStats
+ent_tick_stats(void)
+{
+	return tick_stats;
+}
+
+ObjectPoolStats
+ent_pool_stats(void)
+{
+	ObjectPoolStats stats = { 0 };
+
+	for(EntityType type = ENTITY_NULL + 1; type < LAST_ENTITY; type++) {
+		ObjectPoolStats type_stats = objpool_stats(&objects[type]);
+
+		stats.resident_bytes  += type_stats.resident_bytes;
+		stats.live_bytes      += type_stats.live_bytes;
+		stats.free_bytes      += type_stats.free_bytes;
+		stats.resident_pages  += type_stats.resident_pages;
+		stats.reclaimed_pages += type_stats.reclaimed_pages;
+	}
+	return stats;
+}
+
 bool
 ent_implements(Entity *e, ptrdiff_t offset)
 {
@@ -101,24 +657,63 @@ ent_take_damage(Entity *e, float damage, vec2 damage_indicator_pos)
 {
 	EntityObject *obj = CONTAINER_OF(e, EntityObject, data);
 
+	if(SDL_TLSGet(chunk_queue)) {
+		DamageCommand command = { .target = ent_id(e), .damage = damage };
+
+		vec2_dup(command.position, damage_indicator_pos);
+		ent_defer(take_damage, &command, sizeof(command));
+		return;
+	}
 	if(obj->interface->take_damage) {
+		DamageNumberCommand command = { .damage = damage };
+
 		obj->interface->take_damage(e, damage);
-		ent_damage_number(damage_indicator_pos, damage);
+		vec2_dup(command.position, damage_indicator_pos);
+		ent_defer(spawn_damage_number, &command, sizeof(command));
 	}
 }
 
+void
+delete_entity(void *data)
+{
+	ent_del(*(Entity**)data);
+}
+
+void
+take_damage(void *data)
+{
+	DamageCommand *command = data;
+	Entity *target = ent_from_id(command->target);
+
+	if(target)
+		ent_take_damage(target, command->damage, command->position);
+}
+
+void
+spawn_damage_number(void *data)
+{
+	DamageNumberCommand *command = data;
+	ent_damage_number(command->position, command->damage);
+}
+
 Entity *
 ent_hover(vec2 mouse_pos)
 {
-	for(EntityObject *obj = objpool_begin(&objects);
-		obj;
-		obj = objpool_next(obj))
-	{
+	Body *bodies[MAX_HOVER_BODIES];
+	PhxFilter filter = { .mask = PHX_LAYER_ENTITIES_BIT, .inactive = true };
+	size_t count = phx_query_aabb(mouse_pos, (vec2){ MAX_HOVER_REACH, MAX_HOVER_REACH }, filter, bodies, MAX_HOVER_BODIES);
+
+	for(size_t i = 0; i < count; i++) {
+		Entity *entity = bodies[i]->entity;
+		if(!entity)
+			continue;
+
+		EntityObject *obj = CONTAINER_OF(entity, EntityObject, data);
 		if(!obj->interface->mouse_hovered)
 			continue;
 		
-		if(obj->interface->mouse_hovered(&obj->data, mouse_pos))
-			return &obj->data;
+		if(obj->interface->mouse_hovered(entity, mouse_pos))
+			return entity;
 	}
 
 	return NULL;
@@ -133,7 +728,7 @@ ent_mouse_interact(Player *who, vec2 mouse_click)
 	if(!who)
 		return;
 
-	vec2_sub(delta_dist, mouse_click, who->body->position);
+	vec2_sub(delta_dist, mouse_click, phx_position(who->body));
 	dist2 = vec2_dot(delta_dist, delta_dist);
 	if(dist2 > (MAX_INTERACT_DIST * MAX_INTERACT_DIST))
 		return;
@@ -1,12 +1,331 @@
+#include <string.h>
+#include <stdint.h>
+
 #include "defs.h"
+#include "util.h"
+#include "physics.h"
+#include "graphics.h"
 #include "entity.h"
+#include "timers.h"
+#include "fns.h"
+
+typedef struct {
+	Body *body;
+} BodyBinding;
+
+typedef struct {
+	SceneObject *object;
+	float *position;
+	Body *follow;
+} SpriteBinding;
+
+typedef struct {
+	TimerID timer;
+} Lifetime;
+
+/* owners and data are parallel arrays, the entity keeps its index in them */
+typedef struct {
+	size_t size;
+	ArrayBuffer owners;
+	ArrayBuffer data;
+	/* entries whose owner was deleted, NULL owners until the next clean */
+	size_t dead;
+} ComponentStore;
+
+static void  *add_component(ComponentType type, Entity *entity);
+static void  *get_component(ComponentType type, Entity *entity);
+static void   remove_component(ComponentType type, Entity *entity);
+static void   clean_store(ComponentType type);
+static size_t store_length(ComponentStore *store);
+static void   lifetime_expired(void *entity_id);
+static void   relocate_bindings(void);
+
+static ComponentStore stores[COMPONENT_COUNT] = {
+	#define COMPONENT(NAME, TYPE) [COMPONENT_##NAME] = { .size = sizeof(TYPE) },
+	COMPONENTS
+	#undef COMPONENT
+};
+
+void
+ent_components_init(void)
+{
+	for(int i = 0; i < COMPONENT_COUNT; i++) {
+		arrbuf_init_allocator(&stores[i].owners, allocator_tagged(ALLOC_TAG_ENTITIES));
+		arrbuf_init_allocator(&stores[i].data,   allocator_tagged(ALLOC_TAG_ENTITIES));
+		stores[i].dead = 0;
+	}
+}
+
+void
+ent_components_end(void)
+{
+	for(int i = 0; i < COMPONENT_COUNT; i++) {
+		arrbuf_free(&stores[i].owners);
+		arrbuf_free(&stores[i].data);
+	}
+}
+
+void
+ent_components_reset(void)
+{
+	for(int i = 0; i < COMPONENT_COUNT; i++) {
+		arrbuf_clear(&stores[i].owners);
+		arrbuf_clear(&stores[i].data);
+		stores[i].dead = 0;
+	}
+}
+
+void
+ent_components_update(float delta)
+{
+	(void)delta;
+	ComponentStore *store;
+
+	/* entities deleted in here only null their owner, so indices stay put */
+	store = &stores[COMPONENT_MOB];
+	for(size_t i = 0; i < store_length(store); i++) {
+		Entity *owner = ((Entity**)store->owners.data)[i];
+		Mob *mob = (Mob*)store->data.data + i;
+
+		if(!owner)
+			continue;
+		if(mob->health > mob->health_max)
+			mob->health = mob->health_max;
+		if(mob->health <= 0.0)
+			ent_del(owner);
+	}
+}
+
+void
+ent_components_render(void)
+{
+	ComponentStore *store = &stores[COMPONENT_SPRITE];
+	SpriteBinding *bindings = store->data.data;
+	Entity **owners = store->owners.data;
+
+	for(size_t i = 0; i < store_length(store); i++) {
+		if(owners[i] && bindings[i].follow)
+			phx_interpolate(bindings[i].follow, bindings[i].position);
+	}
+}
+
+bool
+ent_components_position(Entity *entity, vec2 out)
+{
+	BodyBinding *body = get_component(COMPONENT_BODY, entity);
+	SpriteBinding *sprite;
+
+	if(body) {
+		vec2_dup(out, phx_position(body->body));
+		return true;
+	}
+	sprite = get_component(COMPONENT_SPRITE, entity);
+	if(sprite) {
+		vec2_dup(out, sprite->position);
+		return true;
+	}
+	return false;
+}
+
+void
+ent_components_disable(Entity *entity)
+{
+	BodyBinding *body = get_component(COMPONENT_BODY, entity);
+	Lifetime *lifetime = get_component(COMPONENT_LIFETIME, entity);
+
+	if(lifetime)
+		timers_cancel(lifetime->timer);
+	if(body)
+		body->body->active = false;
+}
+
+void
+ent_components_del(Entity *entity, ArrayBuffer *bodies, ArrayBuffer *scene_objects)
+{
+	BodyBinding *body = get_component(COMPONENT_BODY, entity);
+	SpriteBinding *sprite = get_component(COMPONENT_SPRITE, entity);
+
+	if(body)
+		arrbuf_insert(bodies, sizeof(Body*), &body->body);
+	if(sprite)
+		arrbuf_insert(scene_objects, sizeof(SceneObject*), &sprite->object);
+	for(int i = 0; i < COMPONENT_COUNT; i++)
+		remove_component(i, entity);
+}
+
+void
+ent_components_clean(void)
+{
+	for(int i = 0; i < COMPONENT_COUNT; i++) {
+		if(stores[i].dead)
+			clean_store(i);
+	}
+}
+
+void
+ent_components_snapshot(ArrayBuffer *out)
+{
+	for(int i = 0; i < COMPONENT_COUNT; i++) {
+		arrbuf_snapshot(out, &stores[i].owners);
+		arrbuf_snapshot(out, &stores[i].data);
+		arrbuf_insert(out, sizeof(stores[i].dead), &stores[i].dead);
+	}
+}
 
 void
-mob_process(Entity *entity, Mob *mob) 
+ent_components_restore(Span *snapshot)
 {
-	if(mob->health > mob->health_max)
-		mob->health = mob->health_max;
+	for(int i = 0; i < COMPONENT_COUNT; i++) {
+		Span owners;
 
-	if(mob->health <= 0.0)
+		arrbuf_restore(&stores[i].owners, snapshot);
+		arrbuf_restore(&stores[i].data, snapshot);
+		span_read(snapshot, &stores[i].dead, sizeof(stores[i].dead));
+		owners = arrbuf_span(&stores[i].owners);
+		SPAN_FOR(owners, owner, Entity*) {
+			ent_relocate((void**)owner);
+		}
+	}
+	relocate_bindings();
+}
+
+Mob *
+ent_add_mob(Entity *entity, float health)
+{
+	Mob *mob = add_component(COMPONENT_MOB, entity);
+	mob->health     = health;
+	mob->health_max = health;
+	return mob;
+}
+
+Mob *
+ent_mob(Entity *entity)
+{
+	return get_component(COMPONENT_MOB, entity);
+}
+
+void
+ent_bind_body(Entity *entity, Body *body)
+{
+	BodyBinding *binding = add_component(COMPONENT_BODY, entity);
+	binding->body = body;
+	body->entity = entity;
+}
+
+void
+ent_bind_sprite(Entity *entity, SceneObject *object, float *position, Body *follow)
+{
+	SpriteBinding *binding = add_component(COMPONENT_SPRITE, entity);
+	binding->object   = object;
+	binding->position = position;
+	binding->follow   = follow;
+}
+
+void
+ent_set_lifetime(Entity *entity, float time)
+{
+	Lifetime *lifetime = get_component(COMPONENT_LIFETIME, entity);
+	if(lifetime)
+		timers_cancel(lifetime->timer);
+	else
+		lifetime = add_component(COMPONENT_LIFETIME, entity);
+	lifetime->timer = timers_after(time, lifetime_expired, (void*)(uintptr_t)ent_id(entity));
+}
+
+void *
+add_component(ComponentType type, Entity *entity)
+{
+	ComponentStore *store = &stores[type];
+	unsigned int *index = &ent_component_slots(entity)[type];
+	void *data;
+
+	if(*index)
+		return (char*)store->data.data + (*index - 1) * store->size;
+
+	arrbuf_insert(&store->owners, sizeof(Entity*), &entity);
+	data = arrbuf_newptr(&store->data, store->size);
+	memset(data, 0, store->size);
+	*index = store_length(store);
+	return data;
+}
+
+void *
+get_component(ComponentType type, Entity *entity)
+{
+	ComponentStore *store = &stores[type];
+	unsigned int index = ent_component_slots(entity)[type];
+
+	return index ? (char*)store->data.data + (index - 1) * store->size : NULL;
+}
+
+void
+remove_component(ComponentType type, Entity *entity)
+{
+	ComponentStore *store = &stores[type];
+	unsigned int *index = &ent_component_slots(entity)[type];
+
+	if(!*index)
+		return;
+
+	((Entity**)store->owners.data)[*index - 1] = NULL;
+	*index = 0;
+	store->dead++;
+}
+
+void
+clean_store(ComponentType type)
+{
+	ComponentStore *store = &stores[type];
+	Entity **owners = store->owners.data;
+	size_t length = store_length(store), kept = 0;
+
+	/* keeps the order, so the systems still walk the entities as they were made */
+	for(size_t i = 0; i < length; i++) {
+		if(!owners[i])
+			continue;
+		if(kept != i) {
+			owners[kept] = owners[i];
+			memcpy((char*)store->data.data + kept * store->size, (char*)store->data.data + i * store->size, store->size);
+		}
+		ent_component_slots(owners[kept])[type] = kept + 1;
+		kept++;
+	}
+	store->owners.size = kept * sizeof(Entity*);
+	store->data.size   = kept * store->size;
+	store->dead = 0;
+}
+
+void
+lifetime_expired(void *entity_id)
+{
+	Entity *entity = ent_from_id((uintptr_t)entity_id);
+
+	if(entity) {
+		ent_expire(entity);
 		ent_del(entity);
+	}
+}
+
+void
+relocate_bindings(void)
+{
+	Span bodies = arrbuf_span(&stores[COMPONENT_BODY].data);
+	Span sprites = arrbuf_span(&stores[COMPONENT_SPRITE].data);
+
+	SPAN_FOR(bodies, binding, BodyBinding) {
+		phx_relocate((void**)&binding->body);
+	}
+	SPAN_FOR(sprites, binding, SpriteBinding) {
+		gfx_scene_relocate(&binding->object);
+		/* the position is in the sprite itself or else in the entity */
+		if(!gfx_scene_relocate((void**)&binding->position))
+			ent_relocate((void**)&binding->position);
+		phx_relocate((void**)&binding->follow);
+	}
+}
+
+size_t
+store_length(ComponentStore *store)
+{
+	return arrbuf_length(&store->owners, sizeof(Entity*));
 }
@@ -0,0 +1,42 @@
+#define COMPONENTS \
+	COMPONENT(MOB,      Mob) \
+	COMPONENT(BODY,     BodyBinding) \
+	COMPONENT(SPRITE,   SpriteBinding) \
+	COMPONENT(LIFETIME, Lifetime)
+
+typedef enum {
+	#define COMPONENT(NAME, TYPE) COMPONENT_##NAME,
+	COMPONENTS
+	#undef COMPONENT
+	COMPONENT_COUNT
+} ComponentType;
+
+/* index + 1 of each of the entity's components in their arrays, 0 if it has none */
+unsigned int *ent_component_slots(Entity *entity);
+/* position of the body or else the sprite it is bound to, false if it has neither */
+bool ent_components_position(Entity *entity, vec2 out);
+/* calls the expire callback if it has one */
+void ent_expire(Entity *entity);
+
+void ent_particles_init(void);
+void ent_particles_end(void);
+void ent_particles_reset(void);
+void ent_particles_update(float delta);
+void ent_particles_snapshot(ArrayBuffer *out);
+void ent_particles_restore(Span *snapshot);
+
+void ent_components_init(void);
+void ent_components_end(void);
+void ent_components_reset(void);
+
+void ent_components_update(float delta);
+void ent_components_render(void);
+/* stops the body and lifetime of an entity queued for deletion */
+void ent_components_disable(Entity *entity);
+/* removes the components of an entity being deleted, what they own is appended to be freed by the caller */
+void ent_components_del(Entity *entity, ArrayBuffer *bodies, ArrayBuffer *scene_objects);
+/* packs the arrays, after the deleted entities are done with */
+void ent_components_clean(void);
+/* after the entities, bodies and scene objects are restored, the pointers to them are moved */
+void ent_components_snapshot(ArrayBuffer *out);
+void ent_components_restore(Span *snapshot);
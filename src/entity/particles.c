@@ -0,0 +1,268 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "vecmath.h"
+#include "util.h"
+#include "graphics.h"
+#include "entity.h"
+#include "fns.h"
+
+#define PARTICLE_LAYER     1
+#define PARTICLES_MIN      1024
+#define PARTICLE_HALF_SIZE 0.05f
+#define PARTICLE_DAMPING   5.0f
+#define PARTICLE_SPIN      10.0f
+/* world units of a cell of the map bitmap, doubled until it has at most MAX_SOLID_CELLS */
+#define SOLID_CELL_SIZE    (ENTITY_SCALE / 4)
+#define MAX_SOLID_CELLS    (1 << 22)
+
+#define PARTICLE_FIELDS \
+	PARTICLE_FIELD(x) \
+	PARTICLE_FIELD(y) \
+	PARTICLE_FIELD(velocity_x) \
+	PARTICLE_FIELD(velocity_y) \
+	PARTICLE_FIELD(time) \
+	PARTICLE_FIELD(rotation) \
+	PARTICLE_FIELD(color)
+
+/* one array per field, particle i is at index i of all of them */
+typedef struct {
+	size_t count, capacity;
+	float *x, *y;
+	float *velocity_x, *velocity_y;
+	float *time;
+	float *rotation;
+	vec4  *color;
+} Particles;
+
+/* the collidable map brushes rasterized, outside of it is empty */
+typedef struct {
+	bool *cells;
+	int cols, rows;
+	vec2 origin;
+	float inv_cell_size;
+} SolidMap;
+
+static void grow_particles(size_t count);
+static void free_particles(void);
+static bool is_solid(float x, float y);
+static void draw_particles(void);
+
+static Particles particles;
+static SolidMap solid;
+static Allocator allocator;
+
+void
+ent_particles_init(void)
+{
+	allocator = allocator_tagged(ALLOC_TAG_ENTITIES);
+	memset(&particles, 0, sizeof(particles));
+	memset(&solid, 0, sizeof(solid));
+	grow_particles(PARTICLES_MIN);
+	gfx_scene_set_layer_hook(PARTICLE_LAYER, draw_particles);
+}
+
+void
+ent_particles_end(void)
+{
+	free_particles();
+	if(solid.cells)
+		alloct_deallocate(&allocator, solid.cells);
+	solid.cells = NULL;
+}
+
+void
+ent_particles_reset(void)
+{
+	particles.count = 0;
+}
+
+void
+ent_particles_update(float delta)
+{
+	float damping = fmaxf(1.0f - PARTICLE_DAMPING * delta, 0.0f);
+	size_t kept = 0;
+
+	/* the expired ones are dropped by packing the live ones over them */
+	for(size_t i = 0; i < particles.count; i++) {
+		float time = particles.time[i] - delta;
+		float vx = particles.velocity_x[i] * damping;
+		float vy = particles.velocity_y[i] * damping;
+		float x = particles.x[i], y = particles.y[i];
+		float next_x = x + vx * delta, next_y = y + vy * delta;
+
+		if(time < 0.0f)
+			continue;
+
+		/* bounce off the side that was crossed, both in a corner */
+		if(is_solid(next_x, next_y)) {
+			bool hit_x = is_solid(next_x, y), hit_y = is_solid(x, next_y);
+			if(hit_x || !hit_y) {
+				vx = -vx;
+				next_x = x;
+			}
+			if(hit_y || !hit_x) {
+				vy = -vy;
+				next_y = y;
+			}
+		}
+
+		particles.x[kept]          = next_x;
+		particles.y[kept]          = next_y;
+		particles.velocity_x[kept] = vx;
+		particles.velocity_y[kept] = vy;
+		particles.time[kept]       = time;
+		particles.rotation[kept]   = particles.rotation[i] + delta * PARTICLE_SPIN;
+		if(kept != i)
+			vec4_dup(particles.color[kept], particles.color[i]);
+		kept++;
+	}
+	particles.count = kept;
+}
+
+void
+ent_shot_particles(vec2 position, vec2 velocity, vec4 color, float time, int count)
+{
+	float va = sqrtf(vec2_dot(velocity, velocity));
+
+	if(count <= 0)
+		return;
+	grow_particles(particles.count + count);
+	for(; count > 0; count--) {
+		size_t i = particles.count++;
+		float r = (rand() / (float)RAND_MAX);
+		float rr =  (rand() / (float)RAND_MAX);
+
+		particles.velocity_x[i] = cosf(r * 3.1415926535 * 2) * va * rr;
+		particles.velocity_y[i] = sinf(r * 3.1415926535 * 2) * va * rr;
+		particles.x[i] = position[0] + particles.velocity_x[i] * 0.01;
+		particles.y[i] = position[1] + particles.velocity_y[i] * 0.01;
+		particles.time[i] = time;
+		particles.rotation[i] = 0.0;
+		vec4_dup(particles.color[i], color);
+	}
+}
+
+void
+ent_particles_set_map(Rectangle *solids, size_t count)
+{
+	vec2 min = { INFINITY, INFINITY }, max = { -INFINITY, -INFINITY };
+	float cell_size = SOLID_CELL_SIZE;
+
+	if(solid.cells)
+		alloct_deallocate(&allocator, solid.cells);
+	memset(&solid, 0, sizeof(solid));
+	if(!count)
+		return;
+
+	for(size_t i = 0; i < count; i++) {
+		min[0] = fminf(min[0], solids[i].position[0] - solids[i].half_size[0]);
+		min[1] = fminf(min[1], solids[i].position[1] - solids[i].half_size[1]);
+		max[0] = fmaxf(max[0], solids[i].position[0] + solids[i].half_size[0]);
+		max[1] = fmaxf(max[1], solids[i].position[1] + solids[i].half_size[1]);
+	}
+	while((double)ceilf((max[0] - min[0]) / cell_size) * ceilf((max[1] - min[1]) / cell_size) > MAX_SOLID_CELLS)
+		cell_size *= 2.0f;
+
+	vec2_dup(solid.origin, min);
+	solid.inv_cell_size = 1.0f / cell_size;
+	solid.cols = maxi(ceilf((max[0] - min[0]) * solid.inv_cell_size), 1);
+	solid.rows = maxi(ceilf((max[1] - min[1]) * solid.inv_cell_size), 1);
+	solid.cells = alloct_allocate(&allocator, (size_t)solid.cols * solid.rows * sizeof(*solid.cells));
+	memset(solid.cells, 0, (size_t)solid.cols * solid.rows * sizeof(*solid.cells));
+
+	/* a cell is solid if its center is inside a brush */
+	for(size_t i = 0; i < count; i++) {
+		int x0 = ceilf((solids[i].position[0] - solids[i].half_size[0] - min[0]) * solid.inv_cell_size - 0.5f);
+		int y0 = ceilf((solids[i].position[1] - solids[i].half_size[1] - min[1]) * solid.inv_cell_size - 0.5f);
+		int x1 = ceilf((solids[i].position[0] + solids[i].half_size[0] - min[0]) * solid.inv_cell_size - 0.5f);
+		int y1 = ceilf((solids[i].position[1] + solids[i].half_size[1] - min[1]) * solid.inv_cell_size - 0.5f);
+
+		x0 = maxi(x0, 0); y0 = maxi(y0, 0);
+		x1 = mini(x1, solid.cols); y1 = mini(y1, solid.rows);
+		for(int y = y0; y < y1; y++) {
+			if(x1 > x0)
+				memset(solid.cells + (size_t)y * solid.cols + x0, true, (x1 - x0) * sizeof(*solid.cells));
+		}
+	}
+}
+
+void
+ent_particles_snapshot(ArrayBuffer *out)
+{
+	arrbuf_insert(out, sizeof(particles.count), &particles.count);
+	#define PARTICLE_FIELD(FIELD) \
+		arrbuf_insert(out, particles.count * sizeof(*particles.FIELD), particles.FIELD);
+	PARTICLE_FIELDS
+	#undef PARTICLE_FIELD
+}
+
+void
+ent_particles_restore(Span *snapshot)
+{
+	size_t count;
+
+	span_read(snapshot, &count, sizeof(count));
+	grow_particles(count);
+	particles.count = count;
+	#define PARTICLE_FIELD(FIELD) \
+		span_read(snapshot, particles.FIELD, count * sizeof(*particles.FIELD));
+	PARTICLE_FIELDS
+	#undef PARTICLE_FIELD
+}
+
+size_t
+ent_particles_count(void)
+{
+	return particles.count;
+}
+
+void
+grow_particles(size_t count)
+{
+	size_t capacity = particles.capacity;
+
+	if(count <= capacity)
+		return;
+	while(capacity < count)
+		capacity = capacity ? capacity * 2 : PARTICLES_MIN;
+
+	#define PARTICLE_FIELD(FIELD) \
+		particles.FIELD = particles.FIELD \
+			? alloct_reallocate(&allocator, particles.FIELD, particles.capacity * sizeof(*particles.FIELD), capacity * sizeof(*particles.FIELD)) \
+			: alloct_allocate(&allocator, capacity * sizeof(*particles.FIELD));
+	PARTICLE_FIELDS
+	#undef PARTICLE_FIELD
+	particles.capacity = capacity;
+}
+
+void
+free_particles(void)
+{
+	#define PARTICLE_FIELD(FIELD) \
+		alloct_deallocate(&allocator, particles.FIELD);
+	PARTICLE_FIELDS
+	#undef PARTICLE_FIELD
+	memset(&particles, 0, sizeof(particles));
+}
+
+bool
+is_solid(float x, float y)
+{
+	int cell_x = floorf((x - solid.origin[0]) * solid.inv_cell_size);
+	int cell_y = floorf((y - solid.origin[1]) * solid.inv_cell_size);
+
+	if(cell_x < 0 || cell_y < 0 || cell_x >= solid.cols || cell_y >= solid.rows)
+		return false;
+	return solid.cells[(size_t)cell_y * solid.cols + cell_x];
+}
+
+void
+draw_particles(void)
+{
+	TextureStamp stamp = get_sprite(SPRITE_UI, 0, 0);
+
+	gfx_push_sprite_batch(&stamp, (vec2){ PARTICLE_HALF_SIZE, PARTICLE_HALF_SIZE }, particles.count,
+		particles.x, particles.y, particles.rotation, particles.color);
+}
@@ -16,6 +16,7 @@
 #include "ui.h"
 #include "audio.h"
 #include "events.h"
+#include "timers.h"
 #include "SDL_events.h"
 
 static void init(void);
@@ -23,6 +24,10 @@ static void end(void);
 static void render(int w, int h);
 static void update(float delta);
 static void mouse_button(SDL_Event *event);
+static void keyboard(SDL_Event *event);
+
+static void save_world(ArrayBuffer *snapshot, ObjectID *player);
+static void load_world(ArrayBuffer *snapshot, ObjectID player);
 
 static void event_receiver(Event event, const void *data);
 static void edit_cbk(UIObject *obj, void *userptr);
@@ -31,13 +36,24 @@ static Map *map;
 static Subscriber *level_subscriber;
 static vec2 camera_position;
 static vec2 mouse_pos;
+/* 
+ * the world right after the map was instantiated, Play and restart restore it
+ * instead of building it again while the map is the same, and the quick save
+ */
+static ArrayBuffer level_snapshot, quick_save;
+static ObjectID level_player, quick_save_player;
+static Map *level_map;
+static uint64_t level_hash;
+static bool has_level_snapshot, has_quick_save;
 
 static GameStateVTable state_vtable = {
 	.init = init,
 	.end = end,
 	.render = render,
 	.update = update,
-	.mouse_button = mouse_button
+	.mouse_button = mouse_button,
+	.keyboard = keyboard,
+	.steady_state = true
 };
 
 void
@@ -83,22 +99,51 @@ init(void)
 	event_subscribe(level_subscriber, EVENT_PLAYER_SPAWN);
 
 	map = editor.map;
+	if(!level_snapshot.initialized) {
+		arrbuf_init_allocator(&level_snapshot, allocator_tagged(ALLOC_TAG_ENTITIES));
+		arrbuf_init_allocator(&quick_save, allocator_tagged(ALLOC_TAG_ENTITIES));
+	}
+	if(has_level_snapshot && level_map == map && level_hash == map_hash(map)) {
+		load_world(&level_snapshot, level_player);
+		return;
+	}
 	map_set_ent_scene(map);
+	save_world(&level_snapshot, &level_player);
+	level_map = map;
+	level_hash = map_hash(map);
+	has_level_snapshot = true;
+	/* the particles of the old map would bounce off the new one */
+	has_quick_save = false;
 }
 
 void
 update(float delta)
 {
-	vec2 offset, delta_pos;
+	vec2 offset, delta_pos, corner;
 	float dist2;
 	Rectangle window_rect = gfx_window_rectangle();
+	Rectangle view;
+
+	/* what the last frame drew, entities far out of it update less often */
+	gfx_pixel_to_world(window_rect.position, view.position);
+	vec2_add(corner, window_rect.position, window_rect.half_size);
+	gfx_pixel_to_world(corner, corner);
+	view.half_size[0] = fabsf(corner[0] - view.position[0]);
+	view.half_size[1] = fabsf(corner[1] - view.position[1]);
+	ent_set_view(&view);
 
 	gfx_scene_update(delta);
 	phx_update(delta);
+	timers_update(delta);
+	/* deletes and spawns from the contact and timer callbacks */
+	ent_flush();
 	ent_update(delta);
 
 	if(GLOBAL.player) {
-		vec2_add_scaled(offset, (vec2){ 0.0, 0.0 }, GLOBAL.player->player.body->position, -32.0);
+		vec2 player_position;
+
+		phx_interpolate(GLOBAL.player->player.body, player_position);
+		vec2_add_scaled(offset, (vec2){ 0.0, 0.0 }, player_position, -32.0);
 		vec2_add(offset, offset, window_rect.position);
 
 		vec2_sub(delta_pos, offset, camera_position);
@@ -118,6 +163,8 @@ render(int w, int h)
 	gfx_clear();
 	gfx_camera_set_enabled(true);
 	gfx_set_camera(camera_position, (vec2){ 32.0, 32.0 });
+	/* sprites bound to bodies are placed between the last two physics steps */
+	ent_render();
 	gfx_scene_draw();
 
 	gfx_camera_set_enabled(false);
@@ -132,6 +179,7 @@ end(void)
 
 	phx_reset();
 	ent_reset();
+	timers_reset();
 	ui_reset();
 	gfx_scene_reset();
 	audio_bgm_pause();
@@ -146,6 +194,53 @@ mouse_button(SDL_Event *event)
 	}
 }
 
+void
+keyboard(SDL_Event *event)
+{
+	if(event->type != SDL_KEYDOWN || event->key.repeat)
+		return;
+
+	switch(event->key.keysym.sym) {
+	case SDLK_F2:
+		load_world(&level_snapshot, level_player);
+		break;
+	case SDLK_F5:
+		save_world(&quick_save, &quick_save_player);
+		has_quick_save = true;
+		break;
+	case SDLK_F9:
+		if(has_quick_save)
+			load_world(&quick_save, quick_save_player);
+		break;
+	default:
+		break;
+	}
+}
+
+void
+save_world(ArrayBuffer *snapshot, ObjectID *player)
+{
+	Uint64 begin = SDL_GetPerformanceCounter();
+
+	ent_snapshot(snapshot);
+	*player = GLOBAL.player ? ent_id(GLOBAL.player) : OBJECT_ID_NULL;
+	printf("SNAPSHOT: saved %zu KiB in %.3f ms\n", snapshot->size / 1024,
+		(SDL_GetPerformanceCounter() - begin) * 1000.0 / SDL_GetPerformanceFrequency());
+	game_restart_steady_state();
+}
+
+void
+load_world(ArrayBuffer *snapshot, ObjectID player)
+{
+	Uint64 begin = SDL_GetPerformanceCounter();
+
+	ent_restore(snapshot);
+	GLOBAL.player = ent_from_id(player);
+	printf("SNAPSHOT: restored %zu KiB in %.3f ms\n", snapshot->size / 1024,
+		(SDL_GetPerformanceCounter() - begin) * 1000.0 / SDL_GetPerformanceFrequency());
+	game_restart_steady_state();
+}
+
 void 
 edit_cbk(UIObject *obj, void *userptr)
 {
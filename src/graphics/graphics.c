@@ -363,6 +363,32 @@ gfx_push_texture_rect(TextureStamp *stamp, vec2 position, vec2 size, vec2 uv_sca
 	sprite_insert(1, &internal);
 }
 
+void
+gfx_push_sprite_batch(TextureStamp *stamp, vec2 half_size, size_t count, float *x, float *y, float *rotation, vec4 *color)
+{
+	SpriteInternal *sprites;
+	vec4 clip;
+
+	if(!count)
+		return;
+	get_global_clip(clip);
+	sprite_buffer_reserve(count);
+	sprites = &sprite_data[sprite_count];
+	for(size_t i = 0; i < count; i++) {
+		sprites[i].type        = stamp->texture;
+		sprites[i].rotation    = rotation[i];
+		sprites[i].position[0] = x[i];
+		sprites[i].position[1] = y[i];
+		vec2_dup(sprites[i].half_size,   half_size);
+		vec2_dup(sprites[i].texpos,      stamp->position);
+		vec2_dup(sprites[i].texsize,     stamp->size);
+		vec4_dup(sprites[i].color,       color[i]);
+		vec4_dup(sprites[i].clip_region, clip);
+		vec2_dup(sprites[i].uvscale,     (vec2){ 1.0, 1.0 });
+	}
+	sprite_count += count;
+}
+
 void
 gfx_push_font2(Font font, vec2 position, float height, vec4 color, const char *fmt, ...)
 {
@@ -71,6 +71,7 @@ static inline Frame *calculate_frame_animation(Animation animation, float time,
 }
 
 static SceneObjectPrivData *layer_objects[SCENE_LAYERS], *layer_objects_end[SCENE_LAYERS];
+static void (*layer_hooks[SCENE_LAYERS])(void);
 static ObjectPool objects;
 static double global_time;
 
@@ -133,8 +134,9 @@ cleanup_callback(ObjectPool *pool, void *ptr)
 void
 gfx_scene_setup(void)
 {
-	objpool_init(&objects, sizeof(SceneObjectPrivData), DEFAULT_ALIGNMENT);
+	objpool_init_dense(&objects, sizeof(SceneObjectPrivData), DEFAULT_ALIGNMENT, allocator_tagged(ALLOC_TAG_SCENE));
 	objects.clean_cbk = cleanup_callback;
+	objpool_set_reclaim(&objects, DEFAULT_RECLAIM_CLEANS);
 	memset(layer_objects, 0, sizeof(layer_objects));
 }
 
@@ -217,6 +219,8 @@ gfx_scene_draw(void)
 			}
 			object_id = object_id->next_layer;
 		}
+		if(layer_hooks[i])
+			layer_hooks[i]();
 	}
 	gfx_flush();
 	gfx_end();
@@ -235,22 +239,83 @@ gfx_scene_del_obj(SceneObject *obj)
 	del_object(CONTAINER_OF(obj, SceneObjectPrivData, data));
 }
 
+ObjectID
+gfx_scene_obj_id(SceneObject *obj)
+{
+	return objpool_id(CONTAINER_OF(obj, SceneObjectPrivData, data));
+}
+
+SceneObject *
+gfx_scene_obj(ObjectID id)
+{
+	SceneObjectPrivData *obj = objpool_from_id(&objects, id);
+	return obj ? &obj->data : NULL;
+}
+
+ObjectPoolStats
+gfx_scene_pool_stats(void)
+{
+	return objpool_stats(&objects);
+}
+
 void
-gfx_scene_update(float delta)
+gfx_scene_snapshot(ArrayBuffer *out)
 {
-	global_time += delta;
+	objpool_snapshot(&objects, out);
+	arrbuf_insert(out, sizeof(layer_objects), layer_objects);
+	arrbuf_insert(out, sizeof(layer_objects_end), layer_objects_end);
+	arrbuf_insert(out, sizeof(global_time), &global_time);
+}
+
+void
+gfx_scene_restore(Span *snapshot, Relocator relocate_text)
+{
+	objpool_restore(&objects, snapshot);
+	span_read(snapshot, layer_objects, sizeof(layer_objects));
+	span_read(snapshot, layer_objects_end, sizeof(layer_objects_end));
+	span_read(snapshot, &global_time, sizeof(global_time));
 	for(int i = 0; i < SCENE_LAYERS; i++) {
-		SceneObjectPrivData *object_id = layer_objects[i];
+		objpool_relocate(&objects, (void**)&layer_objects[i]);
+		objpool_relocate(&objects, (void**)&layer_objects_end[i]);
+	}
+	for(SceneObjectPrivData *object = objpool_begin(&objects);
+		object;
+		object = objpool_next(object))
+	{
+		objpool_relocate(&objects, (void**)&object->next_layer);
+		objpool_relocate(&objects, (void**)&object->prev_layer);
+		if(object->type == SCENE_OBJECT_TEXT)
+			relocate_text((void**)&object->data.text.text_ptr);
+	}
+}
 
-		while(object_id) {
-			switch(object_id->type) {
-			case SCENE_OBJECT_ANIMATED_SPRITE:
-				object_id->data.anim.time += delta;
-			default:
-				do {} while(0);
-			}
+bool
+gfx_scene_relocate(void **ptr)
+{
+	return objpool_relocate(&objects, ptr);
+}
 
-			object_id = object_id->next_layer;
+void
+gfx_scene_set_layer_hook(int layer, void (*draw)(void))
+{
+	assert(layer >= 0 && layer < SCENE_LAYERS);
+	layer_hooks[layer] = draw;
+}
+
+void
+gfx_scene_update(float delta)
+{
+	global_time += delta;
+	/* the order does not matter here, so walk the packed pool instead of the layers */
+	for(SceneObjectPrivData *object_id = objpool_begin(&objects);
+		object_id;
+		object_id = objpool_next(object_id))
+	{
+		switch(object_id->type) {
+		case SCENE_OBJECT_ANIMATED_SPRITE:
+			object_id->data.anim.time += delta;
+		default:
+			do {} while(0);
 		}
 	}
 }
@@ -17,16 +17,31 @@
 #include "audio.h"
 #include "util.h"
 #include "events.h"
+#include "jobs.h"
+#include "timers.h"
 
 static void *cache_line_allocate(size_t size, void *user);
 static void  cache_line_deallocate(void *ptr, void *user);
 static GLADapiproc load_proc(const char *name);
+static void print_memory_stats(void);
+static void print_pool_stats(const char *name, ObjectPoolStats stats);
+#ifdef ZERO_MALLOC
+static void check_steady_state(void);
+#endif
+
+#define FRAME_ARENA_SIZE (64 * 1024)
+#define ZERO_MALLOC_WARMUP_FRAMES 300
 
 Global GLOBAL;
 static float fps_time;
 static int fps;
 static Uint64 rendering_time;
 static GameStateVTable *current_state, *next_state;
+static Arena frame_memory;
+#ifdef ZERO_MALLOC
+static int steady_frames;
+static size_t steady_heap_allocations;
+#endif
 
 int
 main(int argc, char *argv[])
@@ -71,10 +86,14 @@ main(int argc, char *argv[])
 	gladLoadGLES2(load_proc);
 	printf("OpenGL Version: %s\n", glGetString(GL_VERSION));
 
+	arena_init(&frame_memory, FRAME_ARENA_SIZE);
+	/* the main thread works on the jobs too */
+	jobs_init(SDL_GetCPUCount() - 1);
 	event_init();
 	gfx_init();
 	gfx_scene_setup();
 	phx_init();
+	timers_init();
 	ent_init();
 	ui_init();
 	audio_init();
@@ -92,6 +111,11 @@ main(int argc, char *argv[])
 		SDL_Event event;
 		int w, h;
 
+		arena_reset(&frame_memory);
+		alloc_stats_new_frame();
+#ifdef ZERO_MALLOC
+		check_steady_state();
+#endif
 		event_cleanup();
 		ui_cleanup();
 		while(SDL_PollEvent(&event)) {
@@ -160,6 +184,9 @@ main(int argc, char *argv[])
 			current_state = next_state;
 			current_state->init();
 			next_state = NULL;
+#ifdef ZERO_MALLOC
+			steady_frames = 0;
+#endif
 		}
 
 		rendering_time += end_render_time - begin_render_time;
@@ -170,6 +197,7 @@ main(int argc, char *argv[])
 			double rend_time = rendering_time / (double)SDL_GetPerformanceFrequency();
 				   rend_time /= fps;
 			printf("FPS: %d | Avg rend time: %f ms (%0.2f estimated FPS) | sprites rendered: %d | draw count: %d | sprites per draw call: %0.2f \n", fps, rend_time * 1000, 1.0 / rend_time, gfx_debug_sprites_rendered(), gfx_debug_draw_count(), (double)gfx_debug_sprites_rendered() / gfx_debug_draw_count());
+			print_memory_stats();
 			fps_time = 0;
 			fps = 0;
 
@@ -184,10 +212,13 @@ end_loop:
 
 	phx_end();
 	ent_end();
+	timers_end();
 	audio_end();
 	event_terminate();
 	ui_terminate();
 	gfx_terminate();
+	jobs_end();
+	arena_terminate(&frame_memory);
 
 	SDL_DestroyRenderer(GLOBAL.renderer);
 	SDL_DestroyWindow(GLOBAL.window);
@@ -202,6 +233,14 @@ game_change_state_vtable(GameStateVTable *new_vtable)
 	next_state = new_vtable;
 }
 
+void
+game_restart_steady_state(void)
+{
+#ifdef ZERO_MALLOC
+	steady_frames = 0;
+#endif
+}
+
 Allocator
 cache_aligned_allocator(void)
 {
@@ -212,6 +251,18 @@ cache_aligned_allocator(void)
 	};
 }
 
+Arena *
+frame_arena(void)
+{
+	return &frame_memory;
+}
+
+Allocator
+frame_allocator(void)
+{
+	return arena_allocator(&frame_memory);
+}
+
 void
 enable_text_input(void)
 {
@@ -224,6 +275,79 @@ disable_text_input(void)
 	SDL_StopTextInput();
 }
 
+void
+print_memory_stats(void)
+{
+	printf("MEM:");
+	for(int i = 0; i < LAST_ALLOC_TAG; i++) {
+		AllocStats stats = alloc_tag_stats(i);
+		printf(" %s %0.1f KiB (peak %0.1f KiB, %zu allocs/frame) |",
+			alloc_tag_name(i),
+			stats.live_bytes / 1024.0,
+			stats.peak_bytes / 1024.0,
+			stats.frame_allocations);
+	}
+	printf("\n");
+
+	print_pool_stats("entities", ent_pool_stats());
+	print_pool_stats("physics", phx_pool_stats());
+	print_pool_stats("scene", gfx_scene_pool_stats());
+	printf("\n");
+
+	PhxStats phx = phx_stats();
+	printf("PHX: %zu bodies (%zu awake, %zu sleeping), %zu grid nodes, %zu static nodes, %zu pair tests, %zu contacts, %zu substeps (%0.0f Hz), %zu swept hits, cell size %0.2f\n",
+		phx.bodies,
+		phx.awake,
+		phx.sleeping,
+		phx.grid_nodes,
+		phx.static_nodes,
+		phx.pair_tests,
+		phx.contacts,
+		phx.substeps,
+		phx_rate(),
+		phx.swept_hits,
+		phx_cell_size());
+
+	EntityTickStats ticks = ent_tick_stats();
+	printf("ENT: %zu ticked, %zu skipped, %zu particles\n",
+		ticks.ticked,
+		ticks.skipped,
+		ent_particles_count());
+}
+
+void
+print_pool_stats(const char *name, ObjectPoolStats stats)
+{
+	printf("POOL %s: %0.1f KiB resident, %0.1f KiB live, %0.1f KiB free (%zu pages, %zu reclaimed) | ",
+		name,
+		stats.resident_bytes / 1024.0,
+		stats.live_bytes / 1024.0,
+		stats.free_bytes / 1024.0,
+		stats.resident_pages,
+		stats.reclaimed_pages);
+}
+
+#ifdef ZERO_MALLOC
+void
+check_steady_state(void)
+{
+	if(!current_state->steady_state) {
+		steady_frames = 0;
+		return;
+	}
+
+	if(steady_frames < ZERO_MALLOC_WARMUP_FRAMES) {
+		steady_frames++;
+		steady_heap_allocations = heap_allocation_count();
+		return;
+	}
+
+	if(heap_allocation_count() != steady_heap_allocations)
+		die("ZERO_MALLOC: %zu heap allocations in a steady-state frame\n",
+			heap_allocation_count() - steady_heap_allocations);
+}
+#endif
+
 static GLADapiproc load_proc(const char *name) 
 {
 	GLADapiproc proc;
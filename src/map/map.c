@@ -1,21 +1,38 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "entity.h"
 #include "vecmath.h"
 #include "physics.h"
 #include "graphics.h"
 #include "util.h"
+#include "global.h"
 #include "map.h"
 
+/* past this the merge bitmap is too big and every brush gets its own body */
+#define MAX_MERGE_CELLS (1 << 22)
+
 typedef void (*ThingFunc)(Thing *c);
 
+typedef struct {
+	vec2 min, max;
+} CollisionRect;
+
 static void thing_player(Thing *c);
 static void thing_dummy(Thing *c);
 static void thing_door(Thing *c);
 static void thing_world_map(Thing *c);
 
+static size_t build_map_collision(Map *map);
+static void   merge_collision_rects(ArrayBuffer *rects, ArrayBuffer *merged);
+static void   new_map_body(CollisionRect *rect);
+static size_t sort_edges(ArrayBuffer *edges);
+static size_t find_edge(float *edges, size_t count, float value);
+static int    compare_float(const void *a, const void *b);
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size);
+
 static int new_thing_command(Map **map, StrView *tokenview);
 static int thing_position_command(Map **map, StrView *tokenview);
 static int thing_health_command(Map **map, StrView *tokenview);
@@ -66,13 +83,47 @@ map_alloc(void)
 	return map;
 }
 
+Thing *
+map_new_thing(void)
+{
+	Allocator allocator = allocator_tagged(ALLOC_TAG_MAP);
+	Thing *thing = alloct_allocate(&allocator, sizeof(*thing));
+	memset(thing, 0, sizeof(*thing));
+	return thing;
+}
+
+MapBrush *
+map_new_brush(void)
+{
+	Allocator allocator = allocator_tagged(ALLOC_TAG_MAP);
+	MapBrush *brush = alloct_allocate(&allocator, sizeof(*brush));
+	memset(brush, 0, sizeof(*brush));
+	return brush;
+}
+
+void
+map_del_thing(Thing *thing)
+{
+	Allocator allocator = allocator_tagged(ALLOC_TAG_MAP);
+	alloct_deallocate(&allocator, thing);
+}
+
+void
+map_del_brush(MapBrush *brush)
+{
+	Allocator allocator = allocator_tagged(ALLOC_TAG_MAP);
+	alloct_deallocate(&allocator, brush);
+}
+
 Map *
 map_load(const char *file) 
 {
 	FileBuffer fp;
 	Map *map = map_alloc();
+	ArenaCheckpoint checkpoint = arena_checkpoint(frame_arena());
+	Allocator scratch = frame_allocator();
 
-	if(fbuf_open(&fp, file, "r", allocator_default()))
+	if(fbuf_open(&fp, file, "r", scratch))
 		return 0;
 	
 	while(fbuf_read_line(&fp, '\n') != EOF) {
@@ -87,20 +138,21 @@ map_load(const char *file)
 					goto continue_loading;
 			}
 		}
-		char *s = strview_str(word);
+		char *s = strview_str_allocator(word, &scratch);
 		printf("unknown command %s\n", s);
-		free(s);
 
 continue_loading:
 		continue;
 	}
 	fbuf_close(&fp);
+	arena_rewind(frame_arena(), checkpoint);
 
 	return map;
 
 error_load:
 	map_free(map);
 	fbuf_close(&fp);
+	arena_rewind(frame_arena(), checkpoint);
 	return NULL;
 }
 
@@ -111,9 +163,9 @@ map_free(Map *map)
 		next = c->next;
 		for(MapBrush *brush = c->brush_list, *next; brush; brush = next) {
 			next = brush->next;
-			free(brush);
+			map_del_brush(brush);
 		}
-		free(c);
+		map_del_thing(c);
 	}
 	free(map);
 }
@@ -163,15 +215,255 @@ map_export(Map *map, size_t *out_data_size)
 void 
 map_set_ent_scene(Map *map)
 {
+	size_t brushes, bodies;
+
 	for(Thing *c = map->things; c; c = c->next)
 		if(thing_pc[c->type])
 			thing_pc[c->type](c);
+
+	bodies = build_map_collision(map);
+	brushes = 0;
+	for(Thing *c = map->things; c; c = c->next) {
+		if(c->type != THING_WORLD_MAP)
+			continue;
+		for(MapBrush *brush = c->brush_list; brush; brush = brush->next)
+			brushes += !!brush->collidable;
+	}
+	printf("MAP: %zu collidable brushes merged into %zu bodies (%zu removed)\n", brushes, bodies, brushes - bodies);
+	phx_auto_cell_size();
+}
+
+uint64_t
+map_hash(Map *map)
+{
+	/* FNV-1a, a field at a time so the padding is left out */
+	uint64_t hash = 0xCBF29CE484222325ull;
+
+	#define HASH_FIELD(FIELD) hash = hash_bytes(hash, &(FIELD), sizeof(FIELD))
+	for(Thing *c = map->things; c; c = c->next) {
+		HASH_FIELD(c->type);
+		HASH_FIELD(c->layer);
+		HASH_FIELD(c->position);
+		HASH_FIELD(c->health);
+		HASH_FIELD(c->health_max);
+		HASH_FIELD(c->direction);
+		for(MapBrush *brush = c->brush_list; brush; brush = brush->next) {
+			HASH_FIELD(brush->tile);
+			HASH_FIELD(brush->collidable);
+			HASH_FIELD(brush->position);
+			HASH_FIELD(brush->half_size);
+		}
+	}
+	#undef HASH_FIELD
+	return hash;
+}
+
+uint64_t
+hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+	const unsigned char *bytes = data;
+
+	for(size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+	return hash;
+}
+
+/* 
+ * one static body per rectangle of the merged collidable brushes of every
+ * world map thing, returns how many were made
+ */
+size_t
+build_map_collision(Map *map)
+{
+	ArrayBuffer rects, merged;
+	Allocator allocator = allocator_tagged(ALLOC_TAG_MAP);
+	size_t count;
+
+	arrbuf_init_allocator(&rects, allocator);
+	arrbuf_init_allocator(&merged, allocator);
+	for(Thing *c = map->things; c; c = c->next) {
+		if(c->type != THING_WORLD_MAP)
+			continue;
+		for(MapBrush *brush = c->brush_list; brush; brush = brush->next) {
+			CollisionRect *rect;
+			if(!brush->collidable)
+				continue;
+			rect = arrbuf_newptr(&rects, sizeof(CollisionRect));
+			vec2_sub(rect->min, brush->position, brush->half_size);
+			vec2_add(rect->max, brush->position, brush->half_size);
+		}
+	}
+
+	merge_collision_rects(&rects, &merged);
+	/* the greedy cut of a few crossing brushes can take more rectangles than the brushes */
+	if(arrbuf_length(&merged, sizeof(CollisionRect)) > arrbuf_length(&rects, sizeof(CollisionRect))) {
+		ArrayBuffer swap = merged;
+		merged = rects;
+		rects = swap;
+	}
+
+	/* the particles bounce off the same rectangles, reuse rects for them */
+	arrbuf_clear(&rects);
+	Span span = arrbuf_span(&merged);
+	SPAN_FOR(span, rect, CollisionRect) {
+		Rectangle *solid = arrbuf_newptr(&rects, sizeof(Rectangle));
+
+		new_map_body(rect);
+		vec2_add(solid->position, rect->min, rect->max);
+		vec2_mul(solid->position, solid->position, (vec2){ 0.5, 0.5 });
+		vec2_sub(solid->half_size, rect->max, rect->min);
+		vec2_mul(solid->half_size, solid->half_size, (vec2){ 0.5, 0.5 });
+	}
+	count = arrbuf_length(&merged, sizeof(CollisionRect));
+	ent_particles_set_map(rects.data, count);
+
+	arrbuf_free(&rects);
+	arrbuf_free(&merged);
+	return count;
+}
+
+/* 
+ * cuts the plane along every brush edge, marks the cells under a brush and
+ * covers them greedily with rectangles as wide and then as tall as they fit 
+ */
+void
+merge_collision_rects(ArrayBuffer *rects, ArrayBuffer *merged)
+{
+	Allocator allocator = allocator_tagged(ALLOC_TAG_MAP);
+	ArrayBuffer edges_x, edges_y;
+	size_t count_x, count_y, cols, rows;
+	float *xs, *ys;
+	bool *cells;
+
+	arrbuf_init_allocator(&edges_x, allocator);
+	arrbuf_init_allocator(&edges_y, allocator);
+	Span span = arrbuf_span(rects);
+	SPAN_FOR(span, rect, CollisionRect) {
+		arrbuf_insert(&edges_x, sizeof(float), &rect->min[0]);
+		arrbuf_insert(&edges_x, sizeof(float), &rect->max[0]);
+		arrbuf_insert(&edges_y, sizeof(float), &rect->min[1]);
+		arrbuf_insert(&edges_y, sizeof(float), &rect->max[1]);
+	}
+	count_x = sort_edges(&edges_x);
+	count_y = sort_edges(&edges_y);
+	cols = count_x ? count_x - 1 : 0;
+	rows = count_y ? count_y - 1 : 0;
+
+	if(!cols || !rows || (double)cols * rows > MAX_MERGE_CELLS) {
+		arrbuf_free(&edges_x);
+		arrbuf_free(&edges_y);
+		SPAN_FOR(span, rect, CollisionRect) {
+			arrbuf_insert(merged, sizeof(CollisionRect), rect);
+		}
+		return;
+	}
+
+	xs = edges_x.data;
+	ys = edges_y.data;
+	cells = alloct_allocate(&allocator, cols * rows * sizeof(*cells));
+	memset(cells, 0, cols * rows * sizeof(*cells));
+	SPAN_FOR(span, rect, CollisionRect) {
+		size_t x0 = find_edge(xs, count_x, rect->min[0]), x1 = find_edge(xs, count_x, rect->max[0]);
+		size_t y0 = find_edge(ys, count_y, rect->min[1]), y1 = find_edge(ys, count_y, rect->max[1]);
+		for(size_t y = y0; y < y1; y++)
+			memset(cells + y * cols + x0, true, (x1 - x0) * sizeof(*cells));
+	}
+
+	for(size_t y = 0; y < rows; y++) {
+		for(size_t x = 0; x < cols; x++) {
+			size_t width = 0, height = 1;
+			CollisionRect *rect;
+
+			if(!cells[y * cols + x])
+				continue;
+			while(x + width < cols && cells[y * cols + x + width])
+				width++;
+			for(; y + height < rows; height++) {
+				size_t i = 0;
+				while(i < width && cells[(y + height) * cols + x + i])
+					i++;
+				if(i < width)
+					break;
+			}
+			for(size_t i = 0; i < height; i++)
+				memset(cells + (y + i) * cols + x, false, width * sizeof(*cells));
+
+			rect = arrbuf_newptr(merged, sizeof(CollisionRect));
+			rect->min[0] = xs[x];
+			rect->min[1] = ys[y];
+			rect->max[0] = xs[x + width];
+			rect->max[1] = ys[y + height];
+		}
+	}
+
+	alloct_deallocate(&allocator, cells);
+	arrbuf_free(&edges_x);
+	arrbuf_free(&edges_y);
+}
+
+void
+new_map_body(CollisionRect *rect)
+{
+	Body *body = phx_new();
+	body->collision_layer = PHX_LAYER_MAP_BIT;
+	body->solve_layer     = PHX_LAYER_MAP_BIT;
+	body->collision_mask  = 0;
+	body->solve_mask      = 0;
+	body->entity          = NULL;
+	body->no_update       = false;
+	body->is_static       = true;
+	body->mass            = 0.0;
+	body->restitution     = 0.0;
+	vec2_add(phx_position(body), rect->min, rect->max);
+	vec2_mul(phx_position(body), phx_position(body), (vec2){ 0.5, 0.5 });
+	vec2_sub(body->half_size, rect->max, rect->min);
+	vec2_mul(body->half_size, body->half_size, (vec2){ 0.5, 0.5 });
+}
+
+/* sorts the edges and drops the repeated ones, returns how many are left */
+size_t
+sort_edges(ArrayBuffer *edges)
+{
+	float *values = edges->data;
+	size_t count = arrbuf_length(edges, sizeof(float)), unique = 0;
+
+	if(!count)
+		return 0;
+	qsort(values, count, sizeof(float), compare_float);
+	for(size_t i = 1; i < count; i++) {
+		if(values[i] != values[unique])
+			values[++unique] = values[i];
+	}
+	edges->size = (unique + 1) * sizeof(float);
+	return unique + 1;
+}
+
+size_t
+find_edge(float *edges, size_t count, float value)
+{
+	size_t low = 0, high = count;
+
+	while(low < high) {
+		size_t mid = (low + high) / 2;
+		if(edges[mid] < value)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+int
+compare_float(const void *a, const void *b)
+{
+	float fa = *(const float*)a, fb = *(const float*)b;
+	return (fa > fb) - (fa < fb);
 }
 
 int
 new_thing_command(Map **map, StrView *tokenview)
 {
-	Thing *data = calloc(1, sizeof(*data));
+	Thing *data = map_new_thing();
 
 	if(!strview_int(strview_token(tokenview, " "), &data->type))
 		return 1;
@@ -236,7 +528,7 @@ thing_direction_command(Map **map, StrView *tokenview)
 int
 thing_brush_command(Map **map, StrView *tokenview)
 {
-	MapBrush *brush = calloc(1, sizeof(*brush));
+	MapBrush *brush = map_new_brush();
 	Thing *thing = (*map)->things_end;
 	
 	if(!strview_int(strview_token(tokenview, " "), &brush->tile))
@@ -319,22 +611,8 @@ thing_world_map(Thing *c)
 			tiles->sprite_y = (brush->tile - 1) / cols;
 			break;
 		}
-		
-		if(brush->collidable) {
-			Body *body = phx_new();
-			body->collision_layer = PHX_LAYER_MAP_BIT;
-			body->solve_layer     = PHX_LAYER_MAP_BIT;
-			body->collision_mask  = 0;
-			body->solve_mask      = 0;
-			body->entity          = NULL;
-			body->no_update       = false;
-			body->is_static       = true;
-			body->mass            = 0.0;
-			body->restitution     = 0.0;
-			vec2_dup(body->position, brush->position);
-			vec2_dup(body->half_size, brush->half_size);
-		}
 	}
+	/* the collidable brushes become bodies in build_map_collision() */
 }
 
 void
@@ -6,53 +6,251 @@
 #include "util.h"
 #include "vecmath.h"
 #include "physics.h"
+#include "jobs.h"
 
-#define PHYSICS_HZ 480
-#define PHYSICS_TIME (1.0 / PHYSICS_HZ)
 #define SCALE_FACTOR   (1)
 #define DAMPING_FACTOR (1)
 #define EPSILON 0.01
 
+/* a body that stays under these for SLEEP_TIME seconds goes to sleep */
+#define SLEEP_VELOCITY 0.05f
+#define SLEEP_TIME     0.5f
+#define SLEEP_STEPS    ((unsigned int)(SLEEP_TIME / step_time))
+
+/* how deep a swept body is left inside what it hit, so the next step solves the contact */
+#define SWEEP_PENETRATION (EPSILON * 2)
+
+/* 
+ * bodies keep touching until they are this far apart, a body resting on 
+ * another sinks past EPSILON only every few steps and would start and end
+ * the contact each time 
+ */
+#define CONTACT_MARGIN     (EPSILON * 4)
+#define CONTACT_CACHE_MIN  256
+
+#define CONTACT_CHUNKS 32
+#define CONTACT_CHUNK_MIN_BUCKETS 64
+#define CONTACT_CHUNK_MIN_PAIRS 256
+
+/* rays handed to a job at a time by phx_raycast_batch() */
+#define RAYCAST_BATCH 64
+
+#define GRID_BUCKETS  0x10000
+/* bodies are binned by their lowest collision layer, the ones without one go in the last group */
+#define GROUP_COUNT   (PHX_LAYER_COUNT + 1)
+#define MIN_CELL_SIZE 0.5f
+#define MAX_CELL_SIZE 32.0f
+
 typedef unsigned int BodyGridNodeID;
 
 typedef struct {
 	BodyGridNodeID next;
+	/* next node of the same body, only for static nodes */
+	BodyGridNodeID body_next;
 	Body *body;
+	/* the cell of this node and the first cell of the body, see is_reference_cell() */
+	int x, y;
+	int min_x, min_y;
+	unsigned int group;
 } BodyGridNode;
 
+/* the lists of a hash bucket, one per group */
+typedef struct {
+	unsigned int index;
+	BodyGridNodeID head[GROUP_COUNT];
+} GridBucket;
+
 typedef struct {
 	vec2 normal;
 	vec2 pierce;
 	Body *self, *target;
 } Hit;
 
+typedef struct {
+	Body *self, *target;
+} ContactPair;
+
+/* 
+ * candidate pairs of a contiguous range of touched buckets, written by one job
+ * without allocating, a chunk that runs out of room is redone on the main thread
+ */
+typedef struct {
+	size_t bucket_begin, bucket_end;
+	ArrayBuffer pairs;
+	size_t pair_tests;
+	bool overflow;
+} ContactChunk;
+
+/* 
+ * one slot per body in separate arrays, Body.state is the index. The step
+ * streams through them instead of loading every Body, flags has what it
+ * needs of the Body, copied when the body is binned
+ */
+typedef struct {
+	ArrayBuffer position, velocity, accel;
+	ArrayBuffer damping;
+	ArrayBuffer still_steps;
+	ArrayBuffer flags;
+	ArrayBuffer bodies;
+	/* slots of the bodies objpool_clean() gave back, taken by phx_new() first */
+	ArrayBuffer free_slots;
+} BodyState;
+
+enum {
+	STATE_LIVE       = 1 << 0,
+	STATE_STATIC     = 1 << 1,
+	STATE_NO_UPDATE  = 1 << 2,
+	STATE_CONTINUOUS = 1 << 3,
+	STATE_ACTIVE     = 1 << 4,
+	STATE_SLEEPING   = 1 << 5,
+};
+
+typedef struct {
+	/* the lower ObjectID of the pair in the high bits, 0 for an empty slot */
+	uint64_t key;
+	/* the push solve() gave the pair last time, to warm start the next one */
+	float impulse;
+	bool seen;
+} CachedContact;
+
+/* 
+ * open addressing with linear probing, rebuilt every step. The filled slots
+ * are listed in used, so clearing and walking it don't touch the whole table.
+ */
+typedef struct {
+	CachedContact *slots;
+	ArrayBuffer used;
+	size_t count, capacity;
+} ContactCache;
+
+typedef struct {
+	PhxRay *rays;
+	size_t count;
+	PhxFilter filter;
+} RaycastBatch;
+
 static bool have_to_test(Body *self, Body *target);
+static bool have_to_solve(Body *self, Body *target);
+static unsigned int body_group(Body *body);
+static void update_group_pairs(unsigned long long int *layers, unsigned long long int *masks);
 
-static BodyGridNodeID grid_to_id(BodyGridNode *node);
-static BodyGridNode*  id_to_grid(BodyGridNodeID id);
+static BodyGridNodeID grid_to_id(ArrayBuffer *arena, BodyGridNode *node);
+static BodyGridNode*  id_to_grid(ArrayBuffer *arena, BodyGridNodeID id);
+static GridBucket*    get_bucket(ArrayBuffer *buckets, unsigned int *list, unsigned int bucket_index);
+static GridBucket*    find_bucket(ArrayBuffer *buckets, unsigned int *list, unsigned int bucket_index);
 
+static void clear_grid(void);
 static void calculate_grid(void);
+static void body_cells(Body *body, int *min_x, int *min_y, int *max_x, int *max_y);
+static void insert_static_body(Body *body);
+static void remove_static_body(Body *body);
+static bool static_body_moved(Body *body);
+static void clear_static_grid(void);
+static void body_cleanup(ObjectPool *pool, void *body);
+static void snapshot_grid(ArrayBuffer *out, ArrayBuffer *arena, ArrayBuffer *buckets, unsigned int *list);
+static void restore_grid(Span *snapshot, ArrayBuffer *arena, ArrayBuffer *buckets, unsigned int *list);
 
 static bool body_check_collision(Body * self, Body * target, Contact *contact);
-static void update_body(Body * body, float delta);
-static void update_body_grid(BodyGridNodeID self_grid, BodyGridNodeID other_grid);
+static bool update_sleep(size_t slot);
+static bool should_wake(Body *body);
+static void copy_state_flags(Body *body);
+static unsigned char *state_flags(Body *body);
+static void  integrate_bodies(float delta);
+static float sweep_body(Body *body, vec2 move);
+static float sweep_time_of_impact(Body *body, vec2 move, Body *target);
+static bool  segment_box(vec2 origin, vec2 move, vec2 low, vec2 high, float *time, int *axis);
+static void find_contacts(void);
+static void find_chunk_contacts(int index, void *userptr);
+static void collect_chunk_pairs(ContactChunk *chunk, bool grow);
+static bool collect_bucket_pairs(ContactChunk *chunk, bool grow, GridBucket *bucket, GridBucket *static_bucket);
+static bool collect_pairs(ContactChunk *chunk, bool grow, BodyGridNode *self_node, ArrayBuffer *target_arena, BodyGridNodeID target_id);
+static void resolve_contacts(void);
+static void end_contacts(ContactCache *last, ContactCache *cache);
+static bool bodies_near(Body *self, Body *target);
+static bool may_touch(Body *self, Body *target);
 
-static void solve(Contact *contact);
-static int  hash(int x, int y);
+static uint64_t       contact_key(Body *self, Body *target);
+static CachedContact* cache_find(ContactCache *cache, uint64_t key);
+static CachedContact* cache_insert(ContactCache *cache, uint64_t key);
+static void           cache_clear(ContactCache *cache, size_t expected);
+static void           cache_free(ContactCache *cache);
+static void           cache_snapshot(ArrayBuffer *out, ContactCache *cache);
+static void           cache_restore(Span *snapshot, ContactCache *cache);
+
+static bool   query_accepts(PhxFilter *filter, Body *target);
+static bool   query_overlaps(Body *body, vec2 position, vec2 half_size);
+static size_t query_bucket(ArrayBuffer *arena, GridBucket *bucket, int x, int y, int min_x, int min_y, vec2 position, vec2 half_size, PhxFilter *filter, Body **bodies, size_t count, size_t max_bodies);
+static void   raycast_bucket(ArrayBuffer *arena, GridBucket *bucket, int x, int y, vec2 from, vec2 move, PhxFilter *filter, PhxRayHit *hit);
+static void   raycast_batch_job(int index, void *userptr);
+
+static bool is_reference_cell(BodyGridNode *self, BodyGridNode *target);
+static int  compare_float(const void *a, const void *b);
+
+static void solve(Contact *contact, float *impulse);
+static unsigned int hash(int x, int y);
 
 static float accumulator_time;
+static float step_time = 1.0f / PHX_DEFAULT_RATE;
+static int   max_substeps = PHX_DEFAULT_MAX_SUBSTEPS;
 static ArrayBuffer grid_node_arena;
-static BodyGridNodeID grid_list[0x10000];
-static BodyGridNodeID static_grid_list[0x10000];
+/* index + 1 of the GridBucket in touched_buckets */
+static unsigned int grid_list[GRID_BUCKETS];
+/* buckets that are not empty, so clearing and walking the grid don't touch the whole table */
+static ArrayBuffer touched_buckets;
+/* 
+ * static bodies are kept here between steps, they are only inserted again 
+ * when they move, get deleted or the cell size changes 
+ */
+static ArrayBuffer static_node_arena;
+static ArrayBuffer static_free_nodes;
+static ArrayBuffer static_buckets;
+static unsigned int static_grid_list[GRID_BUCKETS];
+static bool static_grid_dirty;
 static ObjectPool objects;
+static float cell_size = PHX_DEFAULT_CELL_SIZE;
+static PhxStats stats;
+static BodyState state;
+static ContactChunk contact_chunks[CONTACT_CHUNKS];
+static int contact_chunk_count;
+/* 
+ * bit j of group_pairs[i] is set if some body of group i may touch one of 
+ * group j, from the layers and masks of the bodies binned this step 
+ */
+static unsigned int group_pairs[GROUP_COUNT];
+/* the contacts of the last step and the ones being found, swapped every step */
+static ContactCache contact_caches[2];
+static int contact_cache_current;
+/* counts from 1, so a new body's contact_step of 0 is never the last step */
+static unsigned int contact_step = 1;
 
 static void (*pre_solve_callback)(Contact *contact);
 
 void
 phx_init(void)
 {
-	objpool_init(&objects, sizeof(Body), DEFAULT_ALIGNMENT);
-	arrbuf_init(&grid_node_arena);
+	objpool_init_dense(&objects, sizeof(Body), DEFAULT_ALIGNMENT, allocator_tagged(ALLOC_TAG_PHYSICS));
+	phx_set_rate(1.0f / step_time);
+	objects.clean_cbk = body_cleanup;
+	arrbuf_init_allocator(&grid_node_arena, allocator_tagged(ALLOC_TAG_PHYSICS));
+	arrbuf_init_allocator(&touched_buckets, allocator_tagged(ALLOC_TAG_PHYSICS));
+	arrbuf_init_allocator(&static_node_arena, allocator_tagged(ALLOC_TAG_PHYSICS));
+	arrbuf_init_allocator(&static_free_nodes, allocator_tagged(ALLOC_TAG_PHYSICS));
+	arrbuf_init_allocator(&static_buckets, allocator_tagged(ALLOC_TAG_PHYSICS));
+	for(int i = 0; i < CONTACT_CHUNKS; i++)
+		arrbuf_init_allocator(&contact_chunks[i].pairs, allocator_tagged(ALLOC_TAG_PHYSICS));
+	for(int i = 0; i < 2; i++)
+		arrbuf_init_allocator(&contact_caches[i].used, allocator_tagged(ALLOC_TAG_PHYSICS));
+	arrbuf_init_allocator(&state.position, allocator_tagged(ALLOC_TAG_PHYSICS));
+	arrbuf_init_allocator(&state.velocity, allocator_tagged(ALLOC_TAG_PHYSICS));
+	arrbuf_init_allocator(&state.accel, allocator_tagged(ALLOC_TAG_PHYSICS));
+	arrbuf_init_allocator(&state.damping, allocator_tagged(ALLOC_TAG_PHYSICS));
+	arrbuf_init_allocator(&state.still_steps, allocator_tagged(ALLOC_TAG_PHYSICS));
+	arrbuf_init_allocator(&state.flags, allocator_tagged(ALLOC_TAG_PHYSICS));
+	arrbuf_init_allocator(&state.bodies, allocator_tagged(ALLOC_TAG_PHYSICS));
+	arrbuf_init_allocator(&state.free_slots, allocator_tagged(ALLOC_TAG_PHYSICS));
+	memset(grid_list, 0, sizeof(grid_list));
+	memset(static_grid_list, 0, sizeof(static_grid_list));
+	static_grid_dirty = false;
 	accumulator_time = 0;
 }
 
@@ -60,6 +258,22 @@ void
 phx_end(void)
 {
 	arrbuf_free(&grid_node_arena);
+	arrbuf_free(&touched_buckets);
+	arrbuf_free(&static_node_arena);
+	arrbuf_free(&static_free_nodes);
+	arrbuf_free(&static_buckets);
+	for(int i = 0; i < CONTACT_CHUNKS; i++)
+		arrbuf_free(&contact_chunks[i].pairs);
+	cache_free(&contact_caches[0]);
+	cache_free(&contact_caches[1]);
+	arrbuf_free(&state.position);
+	arrbuf_free(&state.velocity);
+	arrbuf_free(&state.accel);
+	arrbuf_free(&state.damping);
+	arrbuf_free(&state.still_steps);
+	arrbuf_free(&state.flags);
+	arrbuf_free(&state.bodies);
+	arrbuf_free(&state.free_slots);
 	objpool_terminate(&objects);
 }
 
@@ -67,6 +281,18 @@ void
 phx_reset(void)
 {
 	objpool_reset(&objects);
+	arrbuf_clear(&state.position);
+	arrbuf_clear(&state.velocity);
+	arrbuf_clear(&state.accel);
+	arrbuf_clear(&state.damping);
+	arrbuf_clear(&state.still_steps);
+	arrbuf_clear(&state.flags);
+	arrbuf_clear(&state.bodies);
+	arrbuf_clear(&state.free_slots);
+	cache_clear(&contact_caches[0], 0);
+	cache_clear(&contact_caches[1], 0);
+	clear_grid();
+	clear_static_grid();
 }
 
 Body * 
@@ -75,39 +301,178 @@ phx_new(void)
 	Body *body = objpool_new(&objects);
 	memset(body, 0, sizeof(*body));
 	body->active = true;
+
+	if(state.free_slots.size) {
+		body->state = *(unsigned int*)arrbuf_peektop(&state.free_slots, sizeof(unsigned int));
+		arrbuf_poptop(&state.free_slots, sizeof(unsigned int));
+	} else {
+		body->state = arrbuf_length(&state.flags, sizeof(unsigned char));
+		arrbuf_newptr(&state.position, sizeof(vec2));
+		arrbuf_newptr(&state.velocity, sizeof(vec2));
+		arrbuf_newptr(&state.accel, sizeof(vec2));
+		arrbuf_newptr(&state.damping, sizeof(float));
+		arrbuf_newptr(&state.still_steps, sizeof(unsigned int));
+		arrbuf_newptr(&state.flags, sizeof(unsigned char));
+		arrbuf_newptr(&state.bodies, sizeof(Body*));
+	}
+	vec2_dup(phx_position(body), (vec2){ 0.0, 0.0 });
+	vec2_dup(phx_velocity(body), (vec2){ 0.0, 0.0 });
+	vec2_dup(phx_accel(body), (vec2){ 0.0, 0.0 });
+	phx_set_damping(body, 0.0f);
+	((unsigned int*)state.still_steps.data)[body->state] = 0;
+	((Body**)state.bodies.data)[body->state] = body;
+	copy_state_flags(body);
 	return body;
 }
 
 void
 phx_del(Body *body)
 {
+	/* the slot is given back by body_cleanup(), the Body is still readable until then */
+	*state_flags(body) = 0;
 	objpool_free(body);
 }
 
+float *
+phx_position(Body *body)
+{
+	return ((vec2*)state.position.data)[body->state];
+}
+
+float *
+phx_velocity(Body *body)
+{
+	return ((vec2*)state.velocity.data)[body->state];
+}
+
+float *
+phx_accel(Body *body)
+{
+	return ((vec2*)state.accel.data)[body->state];
+}
+
+void
+phx_set_damping(Body *body, float damping)
+{
+	((float*)state.damping.data)[body->state] = damping;
+}
+
+unsigned char *
+state_flags(Body *body)
+{
+	return (unsigned char*)state.flags.data + body->state;
+}
+
+/* what integrate_bodies() needs of the Body, refreshed every step */
+void
+copy_state_flags(Body *body)
+{
+	*state_flags(body) = STATE_LIVE
+		| (body->is_static  ? STATE_STATIC     : 0)
+		| (body->no_update  ? STATE_NO_UPDATE  : 0)
+		| (body->continuous ? STATE_CONTINUOUS : 0)
+		| (body->active     ? STATE_ACTIVE     : 0)
+		| (body->sleeping   ? STATE_SLEEPING   : 0);
+}
+
+ObjectID
+phx_id(Body *body)
+{
+	return objpool_id(body);
+}
+
+Body *
+phx_body(ObjectID id)
+{
+	return objpool_from_id(&objects, id);
+}
+
+ObjectPoolStats
+phx_pool_stats(void)
+{
+	return objpool_stats(&objects);
+}
+
+void
+phx_snapshot(ArrayBuffer *out)
+{
+	objpool_snapshot(&objects, out);
+	arrbuf_snapshot(out, &state.position);
+	arrbuf_snapshot(out, &state.velocity);
+	arrbuf_snapshot(out, &state.accel);
+	arrbuf_snapshot(out, &state.damping);
+	arrbuf_snapshot(out, &state.still_steps);
+	arrbuf_snapshot(out, &state.flags);
+	arrbuf_snapshot(out, &state.bodies);
+	arrbuf_snapshot(out, &state.free_slots);
+	arrbuf_insert(out, sizeof(accumulator_time), &accumulator_time);
+	arrbuf_insert(out, sizeof(cell_size), &cell_size);
+	arrbuf_insert(out, sizeof(contact_step), &contact_step);
+	arrbuf_insert(out, sizeof(contact_cache_current), &contact_cache_current);
+	arrbuf_insert(out, sizeof(static_grid_dirty), &static_grid_dirty);
+	cache_snapshot(out, &contact_caches[0]);
+	cache_snapshot(out, &contact_caches[1]);
+	snapshot_grid(out, &grid_node_arena, &touched_buckets, grid_list);
+	snapshot_grid(out, &static_node_arena, &static_buckets, static_grid_list);
+	arrbuf_snapshot(out, &static_free_nodes);
+}
+
+void
+phx_restore(Span *snapshot, Relocator relocate_entity)
+{
+	objpool_restore(&objects, snapshot);
+	for(Body *body = objpool_begin(&objects); body; body = objpool_next(body))
+		relocate_entity((void**)&body->entity);
+	arrbuf_restore(&state.position, snapshot);
+	arrbuf_restore(&state.velocity, snapshot);
+	arrbuf_restore(&state.accel, snapshot);
+	arrbuf_restore(&state.damping, snapshot);
+	arrbuf_restore(&state.still_steps, snapshot);
+	arrbuf_restore(&state.flags, snapshot);
+	arrbuf_restore(&state.bodies, snapshot);
+	arrbuf_restore(&state.free_slots, snapshot);
+	Span bodies = arrbuf_span(&state.bodies);
+	SPAN_FOR(bodies, body, Body*) {
+		if(*body)
+			objpool_relocate(&objects, (void**)body);
+	}
+
+	span_read(snapshot, &accumulator_time, sizeof(accumulator_time));
+	span_read(snapshot, &cell_size, sizeof(cell_size));
+	span_read(snapshot, &contact_step, sizeof(contact_step));
+	span_read(snapshot, &contact_cache_current, sizeof(contact_cache_current));
+	span_read(snapshot, &static_grid_dirty, sizeof(static_grid_dirty));
+	cache_restore(snapshot, &contact_caches[0]);
+	cache_restore(snapshot, &contact_caches[1]);
+	restore_grid(snapshot, &grid_node_arena, &touched_buckets, grid_list);
+	restore_grid(snapshot, &static_node_arena, &static_buckets, static_grid_list);
+	arrbuf_restore(&static_free_nodes, snapshot);
+}
+
+bool
+phx_relocate(void **ptr)
+{
+	return objpool_relocate(&objects, ptr);
+}
+
 void
 phx_update(float delta)
 {
-	accumulator_time += delta;
-	while(accumulator_time > PHYSICS_TIME) {
+	/* a slow frame drops the time past max_substeps instead of making the next one slower */
+	accumulator_time = fminf(accumulator_time + delta, step_time * max_substeps);
+	stats.substeps = 0;
+	stats.swept_hits = 0;
+	while(accumulator_time >= step_time) {
 		objpool_clean(&objects);
 		calculate_grid();
+		find_contacts();
+		resolve_contacts();
+		integrate_bodies(step_time * SCALE_FACTOR);
 
-		for(int i = 0; i < 0x10000; i++) {
-			BodyGridNodeID node_id = grid_list[i];
-			BodyGridNodeID static_node_id = static_grid_list[i];
-			while(node_id) {
-				update_body_grid(node_id, id_to_grid(node_id)->next);
-				update_body_grid(node_id, static_node_id);
-				node_id = id_to_grid(node_id)->next;
-			}
-		}
-		for(Body *body = objpool_begin(&objects); body; body = objpool_next(body))
-			update_body(body, PHYSICS_TIME * SCALE_FACTOR);
-
-		accumulator_time -= PHYSICS_TIME;
+		accumulator_time -= step_time;
+		stats.substeps++;
 	}
-	for(Body *body = objpool_begin(&objects); body; body = objpool_next(body))
-		vec2_dup(body->accel, (vec2){ 0.0, 0.0 });
+	memset(state.accel.data, 0, state.accel.size);
 }
 
 void
@@ -121,52 +486,436 @@ phx_draw(void)
 //		vec2 pos, size;
 //
 //		Body * next = _sys_node(body_id)->next;
-//		vec2_sub(pos, body->position, body->half_size);
+//		vec2_sub(pos, phx_position(body), body->half_size);
 //		vec2_mul(size, body->half_size, (vec2){ 2, 2 });
 //
 //		gfx_debug_set_color((vec4){ 1.0, 1.0, 1.0, 1.0 });
-//		gfx_debug_quad(body->position, body->half_size);
+//		gfx_debug_quad(phx_position(body), body->half_size);
 //
 //		body_id = next;
 //	}
 //	gfx_debug_end();
 }
 
+/* true if the body of the slot just fell asleep */
+bool
+update_sleep(size_t slot)
+{
+	float *velocity = ((vec2*)state.velocity.data)[slot];
+	float *accel = ((vec2*)state.accel.data)[slot];
+	unsigned int *still_steps = (unsigned int*)state.still_steps.data + slot;
+	unsigned char *flags = (unsigned char*)state.flags.data + slot;
+	float speed2 = vec2_dot(velocity, velocity);
+
+	if(speed2 > SLEEP_VELOCITY * SLEEP_VELOCITY || accel[0] != 0 || accel[1] != 0 || !(*flags & STATE_ACTIVE)) {
+		*still_steps = 0;
+		return false;
+	}
+	if(++*still_steps < SLEEP_STEPS)
+		return false;
+
+	((Body**)state.bodies.data)[slot]->sleeping = true;
+	*flags |= STATE_SLEEPING;
+	vec2_dup(velocity, (vec2){ 0.0, 0.0 });
+	return true;
+}
+
+/* something outside of the physics pushed or moved the body */
+bool
+should_wake(Body *body)
+{
+	float *velocity = phx_velocity(body), *accel = phx_accel(body);
+
+	return velocity[0] != 0 || velocity[1] != 0
+		|| accel[0] != 0 || accel[1] != 0
+		|| (body->static_nodes && static_body_moved(body));
+}
+
 void
-update_body(Body * self, float delta)
+phx_wake(Body *body)
 {
-	vec2 accel;
-	
-	if(!self->is_static) {
-		vec2_add_scaled(accel, self->accel, self->velocity, -self->damping * DAMPING_FACTOR * SCALE_FACTOR);
-		vec2_add_scaled(self->velocity, self->velocity, accel, delta);
-		vec2_add_scaled(self->position, self->position, self->velocity, delta);
-	} else {
-		vec2_dup(self->velocity, (vec2){ 0.0, 0.0 });
-		vec2_dup(self->accel, (vec2){ 0.0, 0.0 });
+	body->sleeping = false;
+	((unsigned int*)state.still_steps.data)[body->state] = 0;
+	*state_flags(body) &= ~STATE_SLEEPING;
+}
+
+/* walks the slots and not the bodies, the Body is only loaded by continuous ones */
+void
+integrate_bodies(float delta)
+{
+	size_t count = arrbuf_length(&state.flags, sizeof(unsigned char));
+	unsigned char *flags = state.flags.data;
+	vec2 *position = state.position.data;
+	vec2 *velocity = state.velocity.data;
+	vec2 *accel = state.accel.data;
+	float *damping = state.damping.data;
+
+	for(size_t i = 0; i < count; i++) {
+		float ax, ay;
+		vec2 next;
+
+		if(flags[i] & STATE_STATIC) {
+			vec2_dup(velocity[i], (vec2){ 0.0, 0.0 });
+			vec2_dup(accel[i], (vec2){ 0.0, 0.0 });
+			continue;
+		}
+		if((flags[i] & (STATE_LIVE | STATE_SLEEPING | STATE_NO_UPDATE)) != STATE_LIVE || update_sleep(i))
+			continue;
+
+		ax = accel[i][0] - velocity[i][0] * damping[i] * DAMPING_FACTOR * SCALE_FACTOR;
+		ay = accel[i][1] - velocity[i][1] * damping[i] * DAMPING_FACTOR * SCALE_FACTOR;
+		velocity[i][0] += ax * delta;
+		velocity[i][1] += ay * delta;
+		next[0] = position[i][0] + velocity[i][0] * delta;
+		next[1] = position[i][1] + velocity[i][1] * delta;
+
+		if(flags[i] & STATE_CONTINUOUS) {
+			Body *body = ((Body**)state.bodies.data)[i];
+			vec2 move = { next[0] - position[i][0], next[1] - position[i][1] };
+			vec2_add_scaled(position[i], position[i], move, sweep_body(body, move));
+		} else {
+			vec2_dup(position[i], next);
+		}
 	}
 }
 
+/* 
+ * the fraction of move the body can do before it hits something in the static
+ * grid, plus a bit so it ends up overlapping and the contact is solved normally 
+ */
+float
+sweep_body(Body *body, vec2 move)
+{
+	float inv_cell_size = 1.0f / cell_size;
+	float length = sqrtf(vec2_dot(move, move));
+	float time = 1.0f;
+	unsigned int pairs = group_pairs[body_group(body)];
+	float *position = phx_position(body);
+	int min_x, min_y, max_x, max_y;
+
+	if(length == 0)
+		return 1.0f;
+
+	min_x = floorf((fminf(position[0], position[0] + move[0]) - body->half_size[0]) * inv_cell_size);
+	min_y = floorf((fminf(position[1], position[1] + move[1]) - body->half_size[1]) * inv_cell_size);
+	max_x = floorf((fmaxf(position[0], position[0] + move[0]) + body->half_size[0]) * inv_cell_size);
+	max_y = floorf((fmaxf(position[1], position[1] + move[1]) + body->half_size[1]) * inv_cell_size);
+
+	for(int x = min_x; x <= max_x; x++) {
+		for(int y = min_y; y <= max_y; y++) {
+			GridBucket *bucket = find_bucket(&static_buckets, static_grid_list, hash(x, y));
+			if(!bucket)
+				continue;
+
+			for(unsigned int group = 0; group < GROUP_COUNT; group++) {
+				if(!(pairs & (1u << group)))
+					continue;
+
+				BodyGridNodeID node_id = bucket->head[group];
+				for(; node_id; node_id = id_to_grid(&static_node_arena, node_id)->next) {
+					BodyGridNode *node = id_to_grid(&static_node_arena, node_id);
+					Body *target = node->body;
+
+					if(node->x != x || node->y != y || target == body)
+						continue;
+					if(objpool_is_dead(target) || !target->active)
+						continue;
+					if(!(have_to_test(body, target) || have_to_test(target, body)))
+						continue;
+					time = fminf(time, sweep_time_of_impact(body, move, target));
+				}
+			}
+		}
+	}
+
+	if(time >= 1.0f)
+		return 1.0f;
+	stats.swept_hits++;
+	return fminf(time + SWEEP_PENETRATION / length, 1.0f);
+}
+
+/* 
+ * slab test of the body moving by move against target grown by the body's size,
+ * minus the EPSILON body_check_collision() ignores 
+ */
+float
+sweep_time_of_impact(Body *body, vec2 move, Body *target)
+{
+	float *target_position = phx_position(target);
+	vec2 low, high;
+	float time;
+	int axis;
+
+	for(int i = 0; i < 2; i++) {
+		low[i]  = target_position[i] - target->half_size[i] - body->half_size[i] + EPSILON;
+		high[i] = target_position[i] + target->half_size[i] + body->half_size[i] - EPSILON;
+	}
+
+	/* already overlapping, or missing it: the discrete test handles the first */
+	if(!segment_box(phx_position(body), move, low, high, &time, &axis) || time < 0)
+		return 1.0f;
+	return time;
+}
+
+/* 
+ * slab test of origin moving by move against the box from low to high, time is
+ * when it gets in (negative if it starts inside) and axis the side it crosses 
+ */
+bool
+segment_box(vec2 origin, vec2 move, vec2 low, vec2 high, float *time, int *axis)
+{
+	float enter = -INFINITY, leave = INFINITY;
+
+	*axis = -1;
+	for(int i = 0; i < 2; i++) {
+		float t0, t1;
+
+		if(move[i] == 0) {
+			if(origin[i] <= low[i] || origin[i] >= high[i])
+				return false;
+			continue;
+		}
+		t0 = (low[i]  - origin[i]) / move[i];
+		t1 = (high[i] - origin[i]) / move[i];
+		if(fminf(t0, t1) > enter) {
+			enter = fminf(t0, t1);
+			*axis = i;
+		}
+		leave = fminf(leave, fmaxf(t0, t1));
+	}
+
+	if(enter > leave || enter > 1 || leave < 0)
+		return false;
+	*time = enter;
+	return true;
+}
+
 void
-update_body_grid(BodyGridNodeID self_grid, BodyGridNodeID target_id_grid)
+phx_set_rate(float hz)
 {
-	Body* self = id_to_grid(self_grid)->body;
+	step_time = 1.0f / hz;
+	/* the pool is cleaned on every step, keep the idle period around the same time */
+	objpool_set_reclaim(&objects, DEFAULT_RECLAIM_CLEANS * fmaxf(hz / 60.0f, 1.0f));
+}
 
-	if(objpool_is_dead(self))
+float
+phx_rate(void)
+{
+	return 1.0f / step_time;
+}
+
+void
+phx_set_max_substeps(int substeps)
+{
+	max_substeps = maxi(substeps, 1);
+}
+
+float
+phx_alpha(void)
+{
+	return fminf(accumulator_time / step_time, 1.0f);
+}
+
+void
+phx_interpolate(Body *body, vec2 position)
+{
+	float alpha = phx_alpha();
+	float *current = phx_position(body);
+
+	if(!body->has_previous) {
+		vec2_dup(position, current);
 		return;
+	}
+	position[0] = body->previous_position[0] + (current[0] - body->previous_position[0]) * alpha;
+	position[1] = body->previous_position[1] + (current[1] - body->previous_position[1]) * alpha;
+}
+
+/* 
+ * splits the touched buckets in chunks and collects the overlapping pairs of
+ * each one on the job pool, nothing is written to the bodies here
+ */
+void
+find_contacts(void)
+{
+	size_t bucket_count = arrbuf_length(&touched_buckets, sizeof(GridBucket));
+
+	contact_chunk_count = clampi(bucket_count / CONTACT_CHUNK_MIN_BUCKETS, 1, CONTACT_CHUNKS);
+	for(int i = 0; i < contact_chunk_count; i++) {
+		ContactChunk *chunk = &contact_chunks[i];
+		chunk->bucket_begin = bucket_count * i / contact_chunk_count;
+		chunk->bucket_end   = bucket_count * (i + 1) / contact_chunk_count;
+		arrbuf_clear(&chunk->pairs);
+		arrbuf_reserve(&chunk->pairs, CONTACT_CHUNK_MIN_PAIRS * sizeof(ContactPair));
+	}
+
+	jobs_parallel_for(contact_chunk_count, find_chunk_contacts, NULL);
+
+	stats.pair_tests = 0;
+	for(int i = 0; i < contact_chunk_count; i++) {
+		if(contact_chunks[i].overflow)
+			collect_chunk_pairs(&contact_chunks[i], true);
+		stats.pair_tests += contact_chunks[i].pair_tests;
+	}
+}
+
+void
+find_chunk_contacts(int index, void *userptr)
+{
+	(void)userptr;
+	collect_chunk_pairs(&contact_chunks[index], false);
+}
+
+void
+collect_chunk_pairs(ContactChunk *chunk, bool grow)
+{
+	GridBucket *buckets = touched_buckets.data;
+
+	arrbuf_clear(&chunk->pairs);
+	chunk->pair_tests = 0;
+	chunk->overflow = false;
+
+	for(size_t i = chunk->bucket_begin; i < chunk->bucket_end; i++) {
+		GridBucket *static_bucket = find_bucket(&static_buckets, static_grid_list, buckets[i].index);
+		if(!collect_bucket_pairs(chunk, grow, &buckets[i], static_bucket)) {
+			chunk->overflow = true;
+			return;
+		}
+	}
+}
+
+/* 
+ * every moving body against the moving ones after it and the static ones,
+ * only on the lists of the groups it may touch 
+ */
+bool
+collect_bucket_pairs(ContactChunk *chunk, bool grow, GridBucket *bucket, GridBucket *static_bucket)
+{
+	for(unsigned int group = 0; group < GROUP_COUNT; group++) {
+		unsigned int pairs = group_pairs[group];
+		if(!pairs)
+			continue;
 
-	for(; target_id_grid; target_id_grid = id_to_grid(target_id_grid)->next) {
-		Contact contact = {0};
-		Body *target = id_to_grid(target_id_grid)->body;
+		BodyGridNodeID node_id = bucket->head[group];
+		while(node_id) {
+			BodyGridNode *node = id_to_grid(&grid_node_arena, node_id);
+			for(unsigned int target_group = 0; target_group < GROUP_COUNT; target_group++) {
+				if(!(pairs & (1u << target_group)))
+					continue;
 
-		if(objpool_is_dead(target))
+				/* the pairs with an earlier group were collected from that group's side */
+				if(target_group == group && !collect_pairs(chunk, grow, node, &grid_node_arena, node->next))
+					return false;
+				if(target_group > group && !collect_pairs(chunk, grow, node, &grid_node_arena, bucket->head[target_group]))
+					return false;
+				if(static_bucket && !collect_pairs(chunk, grow, node, &static_node_arena, static_bucket->head[target_group]))
+					return false;
+			}
+			node_id = node->next;
+		}
+	}
+	return true;
+}
+
+/* false when the pair buffer is full and grow is false */
+bool
+collect_pairs(ContactChunk *chunk, bool grow, BodyGridNode *self_node, ArrayBuffer *target_arena, BodyGridNodeID target_id)
+{
+	Body *self = self_node->body;
+
+	if(objpool_is_dead(self))
+		return true;
+
+	for(; target_id; target_id = id_to_grid(target_arena, target_id)->next) {
+		BodyGridNode *target_node = id_to_grid(target_arena, target_id);
+		Body *target = target_node->body;
+
+		/* other cells hashed to the same bucket, or a pair already tested in another cell */
+		if(!is_reference_cell(self_node, target_node))
+			continue;
+
+		/* static bodies stay in the grid while inactive (open doors) */
+		if(objpool_is_dead(target) || !target->active)
 			continue;
 
 		if(!(have_to_test(self, target) || have_to_test(target, self))) {
 			continue;
 		}
 
-		if(body_check_collision(self, target, &contact)) {
+		chunk->pair_tests++;
+		if(may_touch(self, target)) {
+			if(!grow && chunk->pairs.size + sizeof(ContactPair) > chunk->pairs.reserved)
+				return false;
+			arrbuf_insert(&chunk->pairs, sizeof(ContactPair), &(ContactPair){ self, target });
+		}
+	}
+	return true;
+}
+
+/* 
+ * runs the callbacks and solves in the same order a single thread would find
+ * the pairs, every pair is tested again because earlier solves moved bodies 
+ * and callbacks may have deleted them
+ */
+void
+resolve_contacts(void)
+{
+	ContactCache *last  = &contact_caches[contact_cache_current];
+	ContactCache *cache = &contact_caches[!contact_cache_current];
+	size_t pair_count = 0;
+
+	for(int i = 0; i < contact_chunk_count; i++)
+		pair_count += arrbuf_length(&contact_chunks[i].pairs, sizeof(ContactPair));
+	cache_clear(cache, last->count + pair_count);
+
+	stats.contacts = 0;
+	stats.contact_enters = 0;
+	for(int i = 0; i < contact_chunk_count; i++) {
+		Span pairs = arrbuf_span(&contact_chunks[i].pairs);
+		SPAN_FOR(pairs, pair, ContactPair) {
+			Contact contact = {0};
+			Body *self = pair->self, *target = pair->target;
+			CachedContact *cached, *entry;
+			uint64_t key;
+			bool overlaps;
+
+			if(objpool_is_dead(self) || objpool_is_dead(target) || !self->active || !target->active)
+				continue;
+
+			/* a pair that touched last step keeps touching inside the margin */
+			overlaps = body_check_collision(self, target, &contact);
+			if(!overlaps && !may_touch(self, target))
+				continue;
+			key = contact_key(self, target);
+			cached = cache_find(last, key);
+			if(!overlaps && !cached)
+				continue;
+
+			self->contact_step = contact_step;
+			target->contact_step = contact_step;
+
+			entry = cache_insert(cache, key);
+			entry->impulse = cached ? cached->impulse : 0.0f;
+			if(cached)
+				cached->seen = true;
+			if(!overlaps)
+				continue;
+
+			/* the callbacks still see sensor contacts, they just aren't solved */
+			contact.active = have_to_solve(self, target) || have_to_solve(target, self);
+			stats.contacts++;
+			if(self->sleeping)
+				phx_wake(self);
+			if(target->sleeping)
+				phx_wake(target);
+
+			if(!cached) {
+				stats.contact_enters++;
+				if(self->contact_enter)
+					self->contact_enter(self, target, &contact);
+				if(target->contact_enter)
+					target->contact_enter(target, self, &contact);
+			}
+
 			if(self->pre_solve)
 				self->pre_solve(self, target, &contact);
 
@@ -174,20 +923,198 @@ update_body_grid(BodyGridNodeID self_grid, BodyGridNodeID target_id_grid)
 				target->pre_solve(target, self, &contact);
 
 			if(contact.active)
-				solve(&contact);
-			
-			if(objpool_is_dead(self))
-				return;
+				solve(&contact, &entry->impulse);
+		}
+	}
+
+	end_contacts(last, cache);
+	contact_cache_current = !contact_cache_current;
+	contact_step++;
+	stats.cached_contacts = cache->count;
+}
+
+/* 
+ * the pairs of last step that were not found again stop touching, unless
+ * both bodies are asleep or static and so were not walked at all 
+ */
+void
+end_contacts(ContactCache *last, ContactCache *cache)
+{
+	Span used = arrbuf_span(&last->used);
+
+	stats.contact_exits = 0;
+	SPAN_FOR(used, slot, size_t) {
+		CachedContact *cached = &last->slots[*slot];
+		Body *self, *target;
+
+		if(cached->seen)
+			continue;
+
+		self   = phx_body(cached->key >> 32);
+		target = phx_body(cached->key & 0xFFFFFFFFu);
+		if(self && target && self->active && target->active
+		&& (self->sleeping || self->is_static) && (target->sleeping || target->is_static)) {
+			cache_insert(cache, cached->key)->impulse = cached->impulse;
+			self->contact_step = contact_step;
+			target->contact_step = contact_step;
+			continue;
 		}
+
+		stats.contact_exits++;
+		if(self && self->contact_exit)
+			self->contact_exit(self, target);
+		if(target && target->contact_exit)
+			target->contact_exit(target, self);
 	}
 }
 
+/* 
+ * the pair overlaps, or both bodies touched something last step and they are 
+ * close enough that they may be a cached contact 
+ */
+bool
+may_touch(Body *self, Body *target)
+{
+	Contact contact;
+
+	if(body_check_collision(self, target, &contact))
+		return true;
+	/* contact_step is on another cache line than the box, test that last */
+	return bodies_near(self, target)
+		&& self->contact_step == contact_step - 1 && target->contact_step == contact_step - 1;
+}
+
+/* the pair overlaps or is closer than CONTACT_MARGIN */
+bool
+bodies_near(Body *self, Body *target)
+{
+	float *self_position = phx_position(self), *target_position = phx_position(target);
+
+	return fabsf(target_position[0] - self_position[0]) < self->half_size[0] + target->half_size[0] + CONTACT_MARGIN
+		&& fabsf(target_position[1] - self_position[1]) < self->half_size[1] + target->half_size[1] + CONTACT_MARGIN;
+}
+
+uint64_t
+contact_key(Body *self, Body *target)
+{
+	uint64_t a = phx_id(self), b = phx_id(target);
+	return a < b ? (a << 32) | b : (b << 32) | a;
+}
+
+CachedContact *
+cache_find(ContactCache *cache, uint64_t key)
+{
+	size_t mask = cache->capacity - 1;
+
+	if(!cache->count)
+		return NULL;
+	for(size_t i = (key * 0x9E3779B97F4A7C15ull) >> 32 & mask; cache->slots[i].key; i = (i + 1) & mask) {
+		if(cache->slots[i].key == key)
+			return &cache->slots[i];
+	}
+	return NULL;
+}
+
+CachedContact *
+cache_insert(ContactCache *cache, uint64_t key)
+{
+	size_t mask, i;
+
+	/* kept at most half full, grown by rehashing into a new table */
+	if((cache->count + 1) * 2 > cache->capacity) {
+		ContactCache grown = {0};
+		Span used = arrbuf_span(&cache->used);
+
+		arrbuf_init_allocator(&grown.used, allocator_tagged(ALLOC_TAG_PHYSICS));
+		cache_clear(&grown, (cache->count + 1) * 2);
+		SPAN_FOR(used, slot, size_t) {
+			*cache_insert(&grown, cache->slots[*slot].key) = cache->slots[*slot];
+		}
+		cache_free(cache);
+		*cache = grown;
+	}
+
+	mask = cache->capacity - 1;
+	for(i = (key * 0x9E3779B97F4A7C15ull) >> 32 & mask; cache->slots[i].key; i = (i + 1) & mask) {
+		if(cache->slots[i].key == key)
+			return &cache->slots[i];
+	}
+	cache->slots[i] = (CachedContact){ .key = key };
+	cache->count++;
+	arrbuf_insert(&cache->used, sizeof(i), &i);
+	return &cache->slots[i];
+}
+
+/* empties the cache, making room for expected contacts */
+void
+cache_clear(ContactCache *cache, size_t expected)
+{
+	size_t capacity = CONTACT_CACHE_MIN;
+
+	while(capacity < expected * 2)
+		capacity *= 2;
+	if(capacity > cache->capacity) {
+		Allocator allocator = allocator_tagged(ALLOC_TAG_PHYSICS);
+		if(cache->slots)
+			alloct_deallocate(&allocator, cache->slots);
+		cache->slots = alloct_allocate(&allocator, capacity * sizeof(CachedContact));
+		cache->capacity = capacity;
+		memset(cache->slots, 0, capacity * sizeof(CachedContact));
+	} else {
+		Span used = arrbuf_span(&cache->used);
+		SPAN_FOR(used, slot, size_t) {
+			cache->slots[*slot].key = 0;
+		}
+	}
+	arrbuf_clear(&cache->used);
+	cache->count = 0;
+}
+
+/* only the filled slots, they are hashed again on restore */
+void
+cache_snapshot(ArrayBuffer *out, ContactCache *cache)
+{
+	Span used = arrbuf_span(&cache->used);
+
+	arrbuf_insert(out, sizeof(cache->count), &cache->count);
+	SPAN_FOR(used, slot, size_t) {
+		arrbuf_insert(out, sizeof(CachedContact), &cache->slots[*slot]);
+	}
+}
+
+void
+cache_restore(Span *snapshot, ContactCache *cache)
+{
+	size_t count;
+
+	span_read(snapshot, &count, sizeof(count));
+	cache_clear(cache, count);
+	for(size_t i = 0; i < count; i++) {
+		CachedContact contact;
+		span_read(snapshot, &contact, sizeof(contact));
+		*cache_insert(cache, contact.key) = contact;
+	}
+}
+
+void
+cache_free(ContactCache *cache)
+{
+	Allocator allocator = allocator_tagged(ALLOC_TAG_PHYSICS);
+
+	if(cache->slots)
+		alloct_deallocate(&allocator, cache->slots);
+	arrbuf_free(&cache->used);
+	cache->slots = NULL;
+	cache->count = 0;
+	cache->capacity = 0;
+}
+
 bool
 body_check_collision(Body *self, Body *target, Contact *contact)
 {
 	vec2 subbed_pos, added_size, min, max;
 
-	vec2_sub(subbed_pos, target->position,  self->position);
+	vec2_sub(subbed_pos, phx_position(target),  phx_position(self));
 	vec2_add(added_size, target->half_size, self->half_size);
 	vec2_sub(min, subbed_pos, added_size);
 	vec2_add(max, subbed_pos, added_size);
@@ -210,79 +1137,299 @@ body_check_collision(Body *self, Body *target, Contact *contact)
 	return true;
 }
 
+/* 
+ * impulse is the push the pair got the last time, it is applied first and 
+ * then corrected, the total push is kept from pulling the bodies together 
+ */
 void
-solve(Contact *contact)
+solve(Contact *contact, float *impulse)
 {
-	float j;
+	float j, push;
 	vec2 vel_rel;
 
 	Body *self = contact->body1;
 	Body *target = contact->body2;
+	float *self_velocity = phx_velocity(self), *target_velocity = phx_velocity(target);
+	float *self_position = phx_position(self), *target_position = phx_position(target);
 
 	float self_inertia = self->is_static ? 0 : 1.0 / self->mass;
 	float target_inertia = target->is_static ? 0 : 1.0 / target->mass;
 
-	vec2_sub(vel_rel, VEC2_DUP(self->velocity), VEC2_DUP(target->velocity));
+	vec2_add_scaled(self_velocity, self_velocity, contact->normal, -*impulse * self_inertia);
+	vec2_add_scaled(target_velocity, target_velocity, contact->normal, *impulse * target_inertia);
+
+	vec2_sub(vel_rel, VEC2_DUP(self_velocity), VEC2_DUP(target_velocity));
 	j = vec2_dot(contact->normal, vel_rel);
 	j *= -(1 + self->restitution + target->restitution);
 	j /= (self_inertia + target_inertia);
+
+	push = fmaxf(*impulse - j, 0.0f);
+	j = *impulse - push;
+	*impulse = push;
 	
-	vec2_add_scaled(self->velocity, self->velocity, contact->normal, j * self_inertia);
-	vec2_add_scaled(target->velocity, target->velocity, contact->normal, -j * target_inertia);
+	vec2_add_scaled(self_velocity, self_velocity, contact->normal, j * self_inertia);
+	vec2_add_scaled(target_velocity, target_velocity, contact->normal, -j * target_inertia);
 
 	if(target->is_static) {
-		vec2_add_scaled(self->position, self->position, contact->pierce, -1.0f);
+		vec2_add_scaled(self_position, self_position, contact->pierce, -1.0f);
 	} else if (self->is_static) {
-		vec2_add_scaled(target->position, target->position, contact->pierce, 1.0f);
+		vec2_add_scaled(target_position, target_position, contact->pierce, 1.0f);
 	} else {
 		float total_mass = self->mass + target->mass;
-		vec2_add_scaled(self->position, self->position, contact->pierce, -(target->mass / total_mass));
-		vec2_add_scaled(target->position, target->position, contact->pierce, self->mass / total_mass);
+		vec2_add_scaled(self_position, self_position, contact->pierce, -(target->mass / total_mass));
+		vec2_add_scaled(target_position, target_position, contact->pierce, self->mass / total_mass);
 	}
 }
 
 BodyGridNodeID
-grid_to_id(BodyGridNode *node)
+grid_to_id(ArrayBuffer *arena, BodyGridNode *node)
 {
-	return (node - (BodyGridNode*)grid_node_arena.data) + 1;
+	return (node - (BodyGridNode*)arena->data) + 1;
 }
 
 BodyGridNode *
-id_to_grid(BodyGridNodeID id)
+id_to_grid(ArrayBuffer *arena, BodyGridNodeID id)
+{
+	return (BodyGridNode*)arena->data + (id - 1);
+}
+
+/* the bucket of bucket_index, added to buckets if it has none */
+GridBucket *
+get_bucket(ArrayBuffer *buckets, unsigned int *list, unsigned int bucket_index)
 {
-	return (BodyGridNode*)grid_node_arena.data + (id - 1);
+	if(!list[bucket_index]) {
+		GridBucket *bucket = arrbuf_newptr(buckets, sizeof(GridBucket));
+		memset(bucket, 0, sizeof(*bucket));
+		bucket->index = bucket_index;
+		list[bucket_index] = arrbuf_length(buckets, sizeof(GridBucket));
+	}
+	return (GridBucket*)buckets->data + (list[bucket_index] - 1);
+}
+
+GridBucket *
+find_bucket(ArrayBuffer *buckets, unsigned int *list, unsigned int bucket_index)
+{
+	if(!list[bucket_index])
+		return NULL;
+	return (GridBucket*)buckets->data + (list[bucket_index] - 1);
 }
 
 void
-calculate_grid(void)
+clear_grid(void)
 {
-	memset(grid_list, 0, sizeof(grid_list));
-	memset(static_grid_list, 0, sizeof(static_grid_list));
+	Span touched = arrbuf_span(&touched_buckets);
+	SPAN_FOR(touched, bucket, GridBucket) {
+		grid_list[bucket->index] = 0;
+	}
+	arrbuf_clear(&touched_buckets);
 	arrbuf_clear(&grid_node_arena);
+}
+
+void
+calculate_grid(void)
+{
+	unsigned long long int group_layers[GROUP_COUNT] = {0}, group_masks[GROUP_COUNT] = {0};
+
+	clear_grid();
+	stats.bodies = 0;
+	stats.sleeping = 0;
+	stats.awake = 0;
+
+	if(static_grid_dirty)
+		clear_static_grid();
 
 	for(Body *body = objpool_begin(&objects); body; body = objpool_next(body)) {
-		if(!body->active)
+		int grid_min_x, grid_min_y, grid_max_x, grid_max_y;
+		unsigned int group = body_group(body);
+
+		vec2_dup(body->previous_position, phx_position(body));
+		body->has_previous = true;
+
+		group_layers[group] |= body->collision_layer;
+		group_masks[group]  |= body->collision_mask;
+
+		if(body->sleeping && should_wake(body))
+			phx_wake(body);
+		copy_state_flags(body);
+
+		/* sleeping bodies don't move, so they are binned with the static ones */
+		if(body->is_static || body->sleeping) {
+			if(body->static_nodes && static_body_moved(body))
+				remove_static_body(body);
+			if(!body->static_nodes)
+				insert_static_body(body);
+			stats.bodies += body->active;
+			stats.sleeping += body->sleeping;
 			continue;
+		}
+		if(body->static_nodes)
+			remove_static_body(body);
 
-		int grid_min_x = floorf(body->position[0] - body->half_size[0]) / GRID_TILE_SIZE;
-		int grid_min_y = floorf(body->position[1] - body->half_size[1]) / GRID_TILE_SIZE;
-		int grid_max_x = floorf(body->position[0] + body->half_size[0]) / GRID_TILE_SIZE;
-		int grid_max_y = floorf(body->position[1] + body->half_size[1]) / GRID_TILE_SIZE;
+		if(!body->active)
+			continue;
+		stats.bodies++;
+		stats.awake++;
 
+		body_cells(body, &grid_min_x, &grid_min_y, &grid_max_x, &grid_max_y);
 		for(int x = grid_min_x; x <= grid_max_x; x++) {
 			for(int y = grid_min_y; y <= grid_max_y; y++) {
+				GridBucket *bucket = get_bucket(&touched_buckets, grid_list, hash(x, y));
 				BodyGridNode *node = arrbuf_newptr(&grid_node_arena, sizeof(BodyGridNode));
-				node->body = body;
-				if(!body->is_static) {
-					node->next = grid_list[hash(x, y)];
-					grid_list[hash(x, y)] = grid_to_id(node);
-				} else {
-					node->next = static_grid_list[hash(x, y)];
-					static_grid_list[hash(x, y)] = grid_to_id(node);
-				}
+
+				node->body  = body;
+				node->x     = x;
+				node->y     = y;
+				node->min_x = grid_min_x;
+				node->min_y = grid_min_y;
+				node->group = group;
+				node->next  = bucket->head[group];
+				bucket->head[group] = grid_to_id(&grid_node_arena, node);
 			}
 		}
 	}
+	update_group_pairs(group_layers, group_masks);
+	stats.grid_nodes   = arrbuf_length(&grid_node_arena, sizeof(BodyGridNode));
+	stats.static_nodes = arrbuf_length(&static_node_arena, sizeof(BodyGridNode)) 
+		- arrbuf_length(&static_free_nodes, sizeof(BodyGridNodeID));
+}
+
+void
+body_cells(Body *body, int *min_x, int *min_y, int *max_x, int *max_y)
+{
+	float inv_cell_size = 1.0f / cell_size;
+	float *position = phx_position(body);
+
+	*min_x = floorf((position[0] - body->half_size[0]) * inv_cell_size);
+	*min_y = floorf((position[1] - body->half_size[1]) * inv_cell_size);
+	*max_x = floorf((position[0] + body->half_size[0]) * inv_cell_size);
+	*max_y = floorf((position[1] + body->half_size[1]) * inv_cell_size);
+}
+
+void
+insert_static_body(Body *body)
+{
+	int grid_min_x, grid_min_y, grid_max_x, grid_max_y;
+	unsigned int group = body_group(body);
+
+	body_cells(body, &grid_min_x, &grid_min_y, &grid_max_x, &grid_max_y);
+	for(int x = grid_min_x; x <= grid_max_x; x++) {
+		for(int y = grid_min_y; y <= grid_max_y; y++) {
+			GridBucket *bucket = get_bucket(&static_buckets, static_grid_list, hash(x, y));
+			BodyGridNodeID *free_id = arrbuf_peektop(&static_free_nodes, sizeof(BodyGridNodeID));
+			BodyGridNode *node;
+
+			if(free_id) {
+				node = id_to_grid(&static_node_arena, *free_id);
+				arrbuf_poptop(&static_free_nodes, sizeof(BodyGridNodeID));
+			} else {
+				node = arrbuf_newptr(&static_node_arena, sizeof(BodyGridNode));
+			}
+			node->body      = body;
+			node->x         = x;
+			node->y         = y;
+			node->min_x     = grid_min_x;
+			node->min_y     = grid_min_y;
+			node->group     = group;
+			node->next      = bucket->head[group];
+			node->body_next = body->static_nodes;
+			bucket->head[group] = grid_to_id(&static_node_arena, node);
+			body->static_nodes  = bucket->head[group];
+		}
+	}
+	vec2_dup(body->static_position, phx_position(body));
+	vec2_dup(body->static_half_size, body->half_size);
+}
+
+void
+remove_static_body(Body *body)
+{
+	BodyGridNodeID node_id = body->static_nodes;
+
+	while(node_id) {
+		BodyGridNode *node = id_to_grid(&static_node_arena, node_id);
+		BodyGridNodeID *link = &find_bucket(&static_buckets, static_grid_list, hash(node->x, node->y))->head[node->group];
+
+		while(*link && *link != node_id)
+			link = &id_to_grid(&static_node_arena, *link)->next;
+		if(*link)
+			*link = node->next;
+
+		arrbuf_insert(&static_free_nodes, sizeof(node_id), &node_id);
+		node_id = node->body_next;
+	}
+	body->static_nodes = 0;
+}
+
+bool
+static_body_moved(Body *body)
+{
+	float *position = phx_position(body);
+
+	return body_group(body) != id_to_grid(&static_node_arena, body->static_nodes)->group
+		|| position[0]  != body->static_position[0]
+		|| position[1]  != body->static_position[1]
+		|| body->half_size[0] != body->static_half_size[0]
+		|| body->half_size[1] != body->static_half_size[1];
+}
+
+void
+clear_static_grid(void)
+{
+	memset(static_grid_list, 0, sizeof(static_grid_list));
+	arrbuf_clear(&static_buckets);
+	arrbuf_clear(&static_node_arena);
+	arrbuf_clear(&static_free_nodes);
+	for(Body *body = objpool_begin(&objects); body; body = objpool_next(body))
+		body->static_nodes = 0;
+	static_grid_dirty = false;
+}
+
+void
+snapshot_grid(ArrayBuffer *out, ArrayBuffer *arena, ArrayBuffer *buckets, unsigned int *list)
+{
+	arrbuf_snapshot(out, arena);
+	arrbuf_snapshot(out, buckets);
+	arrbuf_insert(out, GRID_BUCKETS * sizeof(*list), list);
+}
+
+/* the nodes are kept as they were, only their bodies moved */
+void
+restore_grid(Span *snapshot, ArrayBuffer *arena, ArrayBuffer *buckets, unsigned int *list)
+{
+	Span nodes;
+
+	arrbuf_restore(arena, snapshot);
+	arrbuf_restore(buckets, snapshot);
+	span_read(snapshot, list, GRID_BUCKETS * sizeof(*list));
+	nodes = arrbuf_span(arena);
+	SPAN_FOR(nodes, node, BodyGridNode) {
+		phx_relocate((void**)&node->body);
+	}
+}
+
+void
+body_cleanup(ObjectPool *pool, void *body)
+{
+	unsigned int slot = ((Body*)body)->state;
+
+	(void)pool;
+	if(((Body*)body)->static_nodes)
+		remove_static_body(body);
+	((Body**)state.bodies.data)[slot] = NULL;
+	arrbuf_insert(&state.free_slots, sizeof(unsigned int), &slot);
+}
+
+/* 
+ * a pair sharing several cells is only tested on the first cell both of them
+ * cover, and nodes of different cells that landed on the same bucket are skipped 
+ */
+bool
+is_reference_cell(BodyGridNode *self, BodyGridNode *target)
+{
+	if(self->x != target->x || self->y != target->y)
+		return false;
+	return self->x == maxi(self->min_x, target->min_x) 
+		&& self->y == maxi(self->min_y, target->min_y);
 }
 
 bool
@@ -291,21 +1438,287 @@ have_to_test(Body *self, Body *target)
 	return !!(self->collision_mask & target->collision_layer);
 }
 
+bool
+have_to_solve(Body *self, Body *target)
+{
+	return !!(self->solve_mask & target->solve_layer);
+}
+
+unsigned int
+body_group(Body *body)
+{
+	for(unsigned int layer = 0; layer < PHX_LAYER_COUNT; layer++) {
+		if(body->collision_layer & (1u << layer))
+			return layer;
+	}
+	return PHX_LAYER_COUNT;
+}
+
+/* 
+ * a pair of groups is walked if a mask of one has a layer of the other, two 
+ * particles without a collision layer are never paired this way 
+ */
+void
+update_group_pairs(unsigned long long int *layers, unsigned long long int *masks)
+{
+	for(unsigned int i = 0; i < GROUP_COUNT; i++) {
+		group_pairs[i] = 0;
+		for(unsigned int j = 0; j < GROUP_COUNT; j++) {
+			if((masks[i] & layers[j]) || (masks[j] & layers[i]))
+				group_pairs[i] |= 1u << j;
+		}
+	}
+}
+
 void
 phx_set_pre_solve(void (*pre)(Contact *contact))
 {
 	pre_solve_callback = pre;
 }
 
-static int hash(int x, int y)
+void
+phx_set_cell_size(float size)
+{
+	size = fminf(fmaxf(size, MIN_CELL_SIZE), MAX_CELL_SIZE);
+	if(size != cell_size)
+		static_grid_dirty = true;
+	cell_size = size;
+}
+
+float
+phx_cell_size(void)
+{
+	return cell_size;
+}
+
+void
+phx_auto_cell_size(void)
+{
+	ArrayBuffer extents;
+	size_t count;
+
+	/* twice the median size of the moving bodies, static ones may span many cells */
+	arrbuf_init_allocator(&extents, allocator_tagged(ALLOC_TAG_PHYSICS));
+	for(Body *body = objpool_begin(&objects); body; body = objpool_next(body)) {
+		if(body->is_static)
+			continue;
+		float extent = 2.0f * fmaxf(body->half_size[0], body->half_size[1]);
+		arrbuf_insert(&extents, sizeof(float), &extent);
+	}
+
+	count = arrbuf_length(&extents, sizeof(float));
+	if(count) {
+		qsort(extents.data, count, sizeof(float), compare_float);
+		phx_set_cell_size(2.0f * ((float*)extents.data)[count / 2]);
+	} else {
+		phx_set_cell_size(PHX_DEFAULT_CELL_SIZE);
+	}
+	arrbuf_free(&extents);
+}
+
+PhxStats
+phx_stats(void)
+{
+	return stats;
+}
+
+size_t
+phx_query_aabb(vec2 position, vec2 half_size, PhxFilter filter, Body **bodies, size_t max_bodies)
+{
+	float inv_cell_size = 1.0f / cell_size;
+	size_t count = 0;
+	/* one cell of margin for the bodies that moved since they were binned */
+	int min_x = floorf((position[0] - half_size[0]) * inv_cell_size) - 1;
+	int min_y = floorf((position[1] - half_size[1]) * inv_cell_size) - 1;
+	int max_x = floorf((position[0] + half_size[0]) * inv_cell_size) + 1;
+	int max_y = floorf((position[1] + half_size[1]) * inv_cell_size) + 1;
+
+	/* walking the cells of a box this big costs more than looking at every body */
+	if((double)(max_x - min_x + 1) * (max_y - min_y + 1) > objects.live_count) {
+		for(Body *body = objpool_begin(&objects); body && count < max_bodies; body = objpool_next(body)) {
+			if(query_accepts(&filter, body) && query_overlaps(body, position, half_size))
+				bodies[count++] = body;
+		}
+		return count;
+	}
+
+	for(int x = min_x; x <= max_x; x++) {
+		for(int y = min_y; y <= max_y; y++) {
+			unsigned int bucket_index = hash(x, y);
+			count = query_bucket(&grid_node_arena, find_bucket(&touched_buckets, grid_list, bucket_index), x, y, min_x, min_y,
+				position, half_size, &filter, bodies, count, max_bodies);
+			count = query_bucket(&static_node_arena, find_bucket(&static_buckets, static_grid_list, bucket_index), x, y, min_x, min_y,
+				position, half_size, &filter, bodies, count, max_bodies);
+		}
+	}
+	return count;
+}
+
+size_t
+phx_query_point(vec2 point, PhxFilter filter, Body **bodies, size_t max_bodies)
+{
+	return phx_query_aabb(point, (vec2){ 0.0, 0.0 }, filter, bodies, max_bodies);
+}
+
+/* 
+ * walks the cells under the ray in order and stops at the first cell that ends
+ * after the closest hit so far. A body that left every cell it was binned in
+ * since the last step can be missed.
+ */
+bool
+phx_raycast(vec2 from, vec2 to, PhxFilter filter, PhxRayHit *hit)
 {
-	static const uint16_t multiplier = 40504;
-	uint16_t h = 0;
+	float inv_cell_size = 1.0f / cell_size;
+	vec2 move, next_time, cell_time;
+	int cell[2], last[2], step[2];
+
+	vec2_sub(move, to, from);
+	for(int i = 0; i < 2; i++) {
+		cell[i] = floorf(from[i] * inv_cell_size);
+		last[i] = floorf(to[i] * inv_cell_size);
+		step[i] = (move[i] > 0) - (move[i] < 0);
+		if(step[i]) {
+			next_time[i] = ((cell[i] + (step[i] > 0)) * cell_size - from[i]) / move[i];
+			cell_time[i] = cell_size / fabsf(move[i]);
+		} else {
+			next_time[i] = INFINITY;
+			cell_time[i] = INFINITY;
+		}
+	}
+
+	hit->body = NULL;
+	hit->time = INFINITY;
+	for(int cells = abs(last[0] - cell[0]) + abs(last[1] - cell[1]); cells >= 0; cells--) {
+		unsigned int bucket_index = hash(cell[0], cell[1]);
+		int axis = next_time[0] < next_time[1] ? 0 : 1;
+
+		raycast_bucket(&grid_node_arena, find_bucket(&touched_buckets, grid_list, bucket_index), cell[0], cell[1], from, move, &filter, hit);
+		raycast_bucket(&static_node_arena, find_bucket(&static_buckets, static_grid_list, bucket_index), cell[0], cell[1], from, move, &filter, hit);
+		if(hit->time <= next_time[axis])
+			break;
+
+		cell[axis] += step[axis];
+		next_time[axis] += cell_time[axis];
+	}
+
+	if(!hit->body)
+		return false;
+	vec2_add_scaled(hit->point, from, move, hit->time);
+	return true;
+}
 
-	x /= GRID_TILE_SIZE;
-	y /= GRID_TILE_SIZE;
+void
+phx_raycast_batch(PhxRay *rays, size_t count, PhxFilter filter)
+{
+	RaycastBatch batch = { rays, count, filter };
+	jobs_parallel_for((count + RAYCAST_BATCH - 1) / RAYCAST_BATCH, raycast_batch_job, &batch);
+}
+
+void
+raycast_batch_job(int index, void *userptr)
+{
+	RaycastBatch *batch = userptr;
+	size_t end = ((size_t)index + 1) * RAYCAST_BATCH;
+
+	if(end > batch->count)
+		end = batch->count;
+
+	for(size_t i = (size_t)index * RAYCAST_BATCH; i < end; i++) {
+		PhxRay *ray = &batch->rays[i];
+		ray->hit = phx_raycast(ray->from, ray->to, batch->filter, &ray->result);
+	}
+}
+
+bool
+query_accepts(PhxFilter *filter, Body *target)
+{
+	return !objpool_is_dead(target) && target != filter->ignore
+		&& (target->active || filter->inactive)
+		&& (filter->mask & target->collision_layer);
+}
+
+bool
+query_overlaps(Body *body, vec2 position, vec2 half_size)
+{
+	float *body_position = phx_position(body);
+
+	return fabsf(body_position[0] - position[0]) <= body->half_size[0] + half_size[0]
+		&& fabsf(body_position[1] - position[1]) <= body->half_size[1] + half_size[1];
+}
+
+/* 
+ * appends the bodies of cell x, y that overlap the box, a body is only looked
+ * at on the first cell it shares with the query, like is_reference_cell() 
+ */
+size_t
+query_bucket(ArrayBuffer *arena, GridBucket *bucket, int x, int y, int min_x, int min_y,
+	vec2 position, vec2 half_size, PhxFilter *filter, Body **bodies, size_t count, size_t max_bodies)
+{
+	if(!bucket)
+		return count;
+
+	for(unsigned int group = 0; group < GROUP_COUNT; group++) {
+		BodyGridNodeID node_id = bucket->head[group];
+		for(; node_id && count < max_bodies; node_id = id_to_grid(arena, node_id)->next) {
+			BodyGridNode *node = id_to_grid(arena, node_id);
+
+			if(node->x != x || node->y != y)
+				continue;
+			if(x != maxi(node->min_x, min_x) || y != maxi(node->min_y, min_y))
+				continue;
+			if(query_accepts(filter, node->body) && query_overlaps(node->body, position, half_size))
+				bodies[count++] = node->body;
+		}
+	}
+	return count;
+}
+
+void
+raycast_bucket(ArrayBuffer *arena, GridBucket *bucket, int x, int y, vec2 from, vec2 move, PhxFilter *filter, PhxRayHit *hit)
+{
+	if(!bucket)
+		return;
+
+	for(unsigned int group = 0; group < GROUP_COUNT; group++) {
+		BodyGridNodeID node_id = bucket->head[group];
+		for(; node_id; node_id = id_to_grid(arena, node_id)->next) {
+			BodyGridNode *node = id_to_grid(arena, node_id);
+			Body *body = node->body;
+			vec2 low, high;
+			float time;
+			int axis;
+
+			if(node->x != x || node->y != y || !query_accepts(filter, body))
+				continue;
+
+			vec2_sub(low, phx_position(body), body->half_size);
+			vec2_add(high, phx_position(body), body->half_size);
+			if(!segment_box(from, move, low, high, &time, &axis) || fmaxf(time, 0.0f) >= hit->time)
+				continue;
+
+			hit->body = body;
+			hit->time = fmaxf(time, 0.0f);
+			vec2_dup(hit->normal, (vec2){ 0.0, 0.0 });
+			/* no normal when the ray starts inside */
+			if(time > 0)
+				hit->normal[axis] = move[axis] > 0 ? -1.0f : 1.0f;
+		}
+	}
+}
+
+int
+compare_float(const void *a, const void *b)
+{
+	float fa = *(const float*)a, fb = *(const float*)b;
+	return (fa > fb) - (fa < fb);
+}
+
+static unsigned int hash(int x, int y)
+{
+	uint32_t h = (uint32_t)x * 0x9E3779B1u ^ (uint32_t)y * 0x85EBCA77u;
 
-	h += x * multiplier;
-	h += y * multiplier;
-	return h;
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	return h & (GRID_BUCKETS - 1);
 }
@@ -106,8 +106,8 @@ static vec2 mouse_pos;
 void 
 ui_init(void)
 {
-	arrbuf_init(&should_reparent);
-	objpool_init(&objects, sizeof(UIObjectNode), DEFAULT_ALIGNMENT);
+	arrbuf_init_allocator(&should_reparent, allocator_tagged(ALLOC_TAG_UI));
+	objpool_init_allocator(&objects, sizeof(UIObjectNode), DEFAULT_ALIGNMENT, allocator_tagged(ALLOC_TAG_UI));
 	objects.clean_cbk = cleancbk;
 	
 	ui_reset();
@@ -0,0 +1,129 @@
+#include <stdbool.h>
+#include <SDL.h>
+
+#include "jobs.h"
+
+#define MAX_WORKERS 16
+
+static int  worker_main(void *userptr);
+static void run_jobs(void);
+
+static struct {
+	SDL_Thread *threads[MAX_WORKERS];
+	int worker_count;
+
+	SDL_mutex *mutex;
+	SDL_cond  *work_cond, *done_cond;
+	unsigned int batch;
+	int busy_workers;
+	bool quit;
+
+	void (*job)(int index, void *userptr);
+	void *userptr;
+	int count;
+	SDL_atomic_t next_index;
+} jobs;
+
+void
+jobs_init(int workers)
+{
+	jobs.worker_count = workers < 0 ? 0 : workers > MAX_WORKERS ? MAX_WORKERS : workers;
+	jobs.mutex = SDL_CreateMutex();
+	jobs.work_cond = SDL_CreateCond();
+	jobs.done_cond = SDL_CreateCond();
+	jobs.batch = 0;
+	jobs.busy_workers = 0;
+	jobs.quit = false;
+
+	for(int i = 0; i < jobs.worker_count; i++) {
+		jobs.threads[i] = SDL_CreateThread(worker_main, "job worker", NULL);
+		if(!jobs.threads[i]) {
+			printf("SDL_CreateThread() failed: %s\n", SDL_GetError());
+			jobs.worker_count = i;
+			break;
+		}
+	}
+}
+
+void
+jobs_end(void)
+{
+	SDL_LockMutex(jobs.mutex);
+	jobs.quit = true;
+	SDL_CondBroadcast(jobs.work_cond);
+	SDL_UnlockMutex(jobs.mutex);
+
+	for(int i = 0; i < jobs.worker_count; i++)
+		SDL_WaitThread(jobs.threads[i], NULL);
+	jobs.worker_count = 0;
+
+	SDL_DestroyCond(jobs.done_cond);
+	SDL_DestroyCond(jobs.work_cond);
+	SDL_DestroyMutex(jobs.mutex);
+}
+
+int
+jobs_worker_count(void)
+{
+	return jobs.worker_count;
+}
+
+void
+jobs_parallel_for(int count, void (*job)(int index, void *userptr), void *userptr)
+{
+	if(jobs.worker_count == 0 || count <= 1) {
+		for(int i = 0; i < count; i++)
+			job(i, userptr);
+		return;
+	}
+
+	SDL_LockMutex(jobs.mutex);
+	jobs.job = job;
+	jobs.userptr = userptr;
+	jobs.count = count;
+	SDL_AtomicSet(&jobs.next_index, 0);
+	jobs.busy_workers = jobs.worker_count;
+	jobs.batch++;
+	SDL_CondBroadcast(jobs.work_cond);
+	SDL_UnlockMutex(jobs.mutex);
+
+	run_jobs();
+
+	SDL_LockMutex(jobs.mutex);
+	while(jobs.busy_workers)
+		SDL_CondWait(jobs.done_cond, jobs.mutex);
+	SDL_UnlockMutex(jobs.mutex);
+}
+
+int
+worker_main(void *userptr)
+{
+	unsigned int batch = 0;
+	(void)userptr;
+
+	SDL_LockMutex(jobs.mutex);
+	while(true) {
+		while(!jobs.quit && jobs.batch == batch)
+			SDL_CondWait(jobs.work_cond, jobs.mutex);
+		if(jobs.quit)
+			break;
+		batch = jobs.batch;
+		SDL_UnlockMutex(jobs.mutex);
+
+		run_jobs();
+
+		SDL_LockMutex(jobs.mutex);
+		if(--jobs.busy_workers == 0)
+			SDL_CondSignal(jobs.done_cond);
+	}
+	SDL_UnlockMutex(jobs.mutex);
+	return 0;
+}
+
+void
+run_jobs(void)
+{
+	int index;
+	while((index = SDL_AtomicAdd(&jobs.next_index, 1)) < jobs.count)
+		jobs.job(index, jobs.userptr);
+}
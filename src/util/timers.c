@@ -0,0 +1,209 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "util.h"
+#include "timers.h"
+
+/* 
+ * WHEEL_LEVELS wheels of WHEEL_SLOTS slots, a slot of level l spans 
+ * WHEEL_SLOTS^l ticks. A timer is put in the lowest level its delay fits
+ * in and moved one level down each time the level below wraps around
+ */
+#define WHEEL_BITS   6
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define MAX_DELAY    (((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+typedef struct Timer Timer;
+struct Timer {
+	Timer *next, *prev;
+	/* the list it is in, a slot or the one being fired */
+	Timer **list;
+	uint64_t expires;
+	void (*callback)(void *userptr);
+	void *userptr;
+};
+
+static void insert_timer(Timer *timer);
+static void unlink_timer(Timer *timer);
+static void cascade(int level);
+static void fire_tick(void);
+
+static ObjectPool timers;
+static Timer *wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static Timer *firing;
+static uint64_t current_tick;
+static float accumulator;
+
+void
+timers_init(void)
+{
+	objpool_init_dense(&timers, sizeof(Timer), DEFAULT_ALIGNMENT, allocator_default());
+	objpool_set_reclaim(&timers, DEFAULT_RECLAIM_CLEANS);
+	timers_reset();
+}
+
+void
+timers_end(void)
+{
+	objpool_terminate(&timers);
+}
+
+void
+timers_reset(void)
+{
+	objpool_reset(&timers);
+	memset(wheel, 0, sizeof(wheel));
+	firing = NULL;
+	current_tick = 0;
+	accumulator = 0;
+}
+
+void
+timers_update(float delta)
+{
+	accumulator += delta * TIMERS_TICK_RATE;
+	while(accumulator >= 1.0f) {
+		accumulator -= 1.0f;
+		current_tick++;
+
+		/* each level is moved down when the one below it wraps */
+		for(int level = 1; level < WHEEL_LEVELS; level++) {
+			if(current_tick & (((uint64_t)1 << (WHEEL_BITS * level)) - 1))
+				break;
+			cascade(level);
+		}
+		fire_tick();
+	}
+	objpool_clean(&timers);
+}
+
+TimerID
+timers_after(float seconds, void (*callback)(void *userptr), void *userptr)
+{
+	Timer *timer = objpool_new(&timers);
+	/* the nearest tick, but at least one so a timer made by a callback never runs on the same tick */
+	uint64_t delay = fmaxf(roundf(seconds * TIMERS_TICK_RATE), 1.0f);
+
+	timer->expires  = current_tick + (delay > MAX_DELAY ? MAX_DELAY : delay);
+	timer->callback = callback;
+	timer->userptr  = userptr;
+	insert_timer(timer);
+	return objpool_id(timer);
+}
+
+void
+timers_cancel(TimerID id)
+{
+	Timer *timer = objpool_from_id(&timers, id);
+	if(!timer)
+		return;
+	unlink_timer(timer);
+	objpool_free(timer);
+}
+
+size_t
+timers_count(void)
+{
+	return timers.live_count;
+}
+
+void
+timers_snapshot(ArrayBuffer *out)
+{
+	objpool_snapshot(&timers, out);
+	arrbuf_insert(out, sizeof(wheel), wheel);
+	arrbuf_insert(out, sizeof(current_tick), &current_tick);
+	arrbuf_insert(out, sizeof(accumulator), &accumulator);
+}
+
+void
+timers_restore(Span *snapshot)
+{
+	objpool_restore(&timers, snapshot);
+	span_read(snapshot, wheel, sizeof(wheel));
+	span_read(snapshot, &current_tick, sizeof(current_tick));
+	span_read(snapshot, &accumulator, sizeof(accumulator));
+	firing = NULL;
+
+	/* list points into wheel, which stays where it is */
+	for(int level = 0; level < WHEEL_LEVELS; level++) {
+		for(int slot = 0; slot < WHEEL_SLOTS; slot++)
+			objpool_relocate(&timers, (void**)&wheel[level][slot]);
+	}
+	for(Timer *timer = objpool_begin(&timers); timer; timer = objpool_next(timer)) {
+		objpool_relocate(&timers, (void**)&timer->next);
+		objpool_relocate(&timers, (void**)&timer->prev);
+	}
+}
+
+void
+insert_timer(Timer *timer)
+{
+	uint64_t delay = timer->expires - current_tick;
+	int level = 0;
+
+	while(level < WHEEL_LEVELS - 1 && delay >= ((uint64_t)1 << (WHEEL_BITS * (level + 1))))
+		level++;
+
+	timer->list = &wheel[level][(timer->expires >> (WHEEL_BITS * level)) & WHEEL_MASK];
+	timer->prev = NULL;
+	timer->next = *timer->list;
+	if(timer->next)
+		timer->next->prev = timer;
+	*timer->list = timer;
+}
+
+void
+unlink_timer(Timer *timer)
+{
+	if(timer->prev)
+		timer->prev->next = timer->next;
+	else
+		*timer->list = timer->next;
+	if(timer->next)
+		timer->next->prev = timer->prev;
+	timer->next = timer->prev = NULL;
+}
+
+void
+cascade(int level)
+{
+	Timer **slot = &wheel[level][(current_tick >> (WHEEL_BITS * level)) & WHEEL_MASK];
+	Timer *timer = *slot;
+
+	*slot = NULL;
+	while(timer) {
+		Timer *next = timer->next;
+		insert_timer(timer);
+		timer = next;
+	}
+}
+
+void
+fire_tick(void)
+{
+	Timer **slot = &wheel[0][current_tick & WHEEL_MASK];
+
+	/* 
+	 * the slot is moved to its own list first, so callbacks can cancel any
+	 * timer in it and the new timers they make land in the wheel
+	 */
+	firing = *slot;
+	*slot = NULL;
+	for(Timer *timer = firing; timer; timer = timer->next)
+		timer->list = &firing;
+
+	while(firing) {
+		Timer *timer = firing;
+		void (*callback)(void *userptr) = timer->callback;
+		void *userptr = timer->userptr;
+
+		unlink_timer(timer);
+		objpool_free(timer);
+		callback(userptr);
+	}
+}
@@ -12,14 +12,58 @@
 #define UTF8_FOUR_BYTES 0xF0
 
 #define OBJECT_ALLOCATOR_PAGE_SIZE 1024
+#define OBJECT_PAGE_ALIGNMENT 64
+#define ARENA_ALIGNMENT 16
+/* keeps the size of a tagged allocation, big enough to not break malloc alignment */
+#define TAG_HEADER_SIZE 16
+
+typedef struct ArenaBlock ArenaBlock;
+struct ArenaBlock {
+	size_t size;
+	unsigned char data[];
+};
+
+static size_t heap_allocations;
+static AllocStats alloc_stats[LAST_ALLOC_TAG];
+static size_t frame_allocations[LAST_ALLOC_TAG];
+
+static const char *alloc_tag_names[LAST_ALLOC_TAG] = {
+	#define ALLOC_TAG(NAME) [ALLOC_TAG_##NAME] = #NAME,
+	ALLOC_TAGS
+	#undef ALLOC_TAG
+};
+
+typedef struct ObjectPage ObjectPage;
+struct ObjectPage {
+	size_t live;
+	unsigned int idle;
+	/* highest generation of the page when it was released */
+	uint32_t generation;
+	bool resident;
+};
 
 typedef struct ObjectNode ObjectNode;
 struct ObjectNode {
 	ObjectPool *pool;
 	ObjectNode *next, *prev;
+	size_t dense_index;
+	uint32_t index, generation;
 	bool dead;
 };
 
+/* what objpool_snapshot() writes before the pages */
+typedef struct {
+	size_t node_size, page_count;
+	void *object_list;
+	size_t live_count, reclaimed_pages;
+	uint32_t generation_seed;
+} PoolSnapshot;
+
+typedef struct {
+	uintptr_t from;
+	void *to;
+} PageRelocation;
+
 static uintptr_t align_memory(uintptr_t ptr, size_t align)
 {
 	return (((ptr + align - 1) / align) * align);
@@ -30,19 +74,66 @@ static ObjectNode *data_to_node(void *data)
 	return ((void**)data)[-1];
 }
 
+static void *node_to_data(ObjectPool *pool, ObjectNode *node)
+{
+	return (void*)align_memory((uintptr_t)node + sizeof(void*) + sizeof(ObjectNode), pool->alignment);
+}
+
+static uint32_t next_generation(uint32_t generation)
+{
+	generation = (generation + 1) & OBJECT_ID_GENERATION_MASK;
+	/* generation 0 is reserved so OBJECT_ID_NULL is never valid */
+	return generation ? generation : 1;
+}
+
+static ObjectNode *page_node(ObjectPool *pool, void *page, size_t i)
+{
+	return (ObjectNode*)((uintptr_t)page + pool->node_size * i);
+}
+
+static ObjectPage *node_page(ObjectPool *pool, ObjectNode *node)
+{
+	return (ObjectPage*)pool->page_info.data + node->index / OBJECT_ALLOCATOR_PAGE_SIZE;
+}
+
 static void new_obj_page(ObjectPool *pool)
 {
-	void *page = malloc(pool->node_size * OBJECT_ALLOCATOR_PAGE_SIZE);
-	arrbuf_insert(&pool->pages, sizeof(void*), &page);
+	size_t page_index, page_count = arrbuf_length(&pool->pages, sizeof(void*));
+	uint32_t generation;
+	ObjectPage *info;
+	void *page = alloct_allocate_aligned(&pool->allocator, pool->node_size * OBJECT_ALLOCATOR_PAGE_SIZE, OBJECT_PAGE_ALIGNMENT);
+
+	/* reuse the slot of a released page first, so the handle indices stay bounded */
+	for(page_index = 0; page_index < page_count; page_index++)
+		if(!((void**)pool->pages.data)[page_index])
+			break;
+
+	if(page_index == page_count) {
+		arrbuf_insert(&pool->pages, sizeof(void*), &page);
+		info = arrbuf_newptr(&pool->page_info, sizeof(ObjectPage));
+		info->generation = pool->generation_seed;
+	} else {
+		((void**)pool->pages.data)[page_index] = page;
+		info = (ObjectPage*)pool->page_info.data + page_index;
+	}
+	/* start past anything the slots had before, so old handles stay stale */
+	generation = next_generation(info->generation);
+	info->live = 0;
+	info->idle = 0;
+	info->resident = true;
+
+	assert((page_index + 1) * OBJECT_ALLOCATOR_PAGE_SIZE <= OBJECT_ID_INDEX_MASK && "ObjectPool ran out of handle indices");
 	
 	for(int i = 0; i < OBJECT_ALLOCATOR_PAGE_SIZE; i++) {
-		ObjectNode *node = (ObjectNode*)((uintptr_t)page + pool->node_size * i);
+		ObjectNode *node = page_node(pool, page, i);
 		node->pool = pool;
 		node->prev = NULL;
 		node->next = NULL;
 		node->dead = true;
+		node->index = page_index * OBJECT_ALLOCATOR_PAGE_SIZE + i;
+		node->generation = generation;
 
-		void *data = (void*)align_memory((uintptr_t)node + sizeof(void*) + sizeof(ObjectNode), pool->alignment);
+		void *data = node_to_data(pool, node);
 		/* store the node address before the data itself */
 		((void**)data)[-1] = node;
 		
@@ -52,6 +143,84 @@ static void new_obj_page(ObjectPool *pool)
 	}
 }
 
+static uint32_t page_generation(ObjectPool *pool, void *page)
+{
+	uint32_t highest = 0;
+
+	for(int i = 0; i < OBJECT_ALLOCATOR_PAGE_SIZE; i++) {
+		uint32_t generation = page_node(pool, page, i)->generation;
+		if(generation > highest)
+			highest = generation;
+	}
+	return highest;
+}
+
+/* removes the slots of the pages marked as not resident from the free stack */
+static void drop_free_slots(ObjectPool *pool)
+{
+	void **free_stack = pool->free_stack.data;
+	size_t kept = 0, length = arrbuf_length(&pool->free_stack, sizeof(void*));
+
+	for(size_t i = 0; i < length; i++)
+		if(node_page(pool, data_to_node(free_stack[i]))->resident)
+			free_stack[kept++] = free_stack[i];
+	pool->free_stack.size = kept * sizeof(void*);
+}
+
+/* gives the pages marked as not resident back to the allocator */
+static void release_pages(ObjectPool *pool)
+{
+	ObjectPage *info = pool->page_info.data;
+	void **pages = pool->pages.data;
+
+	for(size_t i = 0; i < arrbuf_length(&pool->pages, sizeof(void*)); i++) {
+		if(!pages[i] || info[i].resident)
+			continue;
+
+		info[i].generation = page_generation(pool, pages[i]);
+		alloct_deallocate_aligned(&pool->allocator, pages[i]);
+		pages[i] = NULL;
+		pool->reclaimed_pages++;
+	}
+}
+
+static size_t resident_pages(ObjectPool *pool)
+{
+	Span span = arrbuf_span(&pool->page_info);
+	size_t count = 0;
+	SPAN_FOR(span, info, ObjectPage) {
+		if(info->resident)
+			count++;
+	}
+	return count;
+}
+
+static void reclaim_idle_pages(ObjectPool *pool)
+{
+	Span span = arrbuf_span(&pool->page_info);
+	size_t resident = resident_pages(pool);
+	bool release = false;
+
+	SPAN_FOR(span, info, ObjectPage) {
+		if(!info->resident)
+			continue;
+		if(info->live) {
+			info->idle = 0;
+			continue;
+		}
+		/* always keep one page around so a single object doesn't thrash the allocator */
+		if(++info->idle >= pool->reclaim_after && resident > 1) {
+			info->resident = false;
+			resident--;
+			release = true;
+		}
+	}
+	if(release) {
+		drop_free_slots(pool);
+		release_pages(pool);
+	}
+}
+
 static void insert_obj_node(ObjectPool *pool, void *data)
 {
 	ObjectNode *node = data_to_node(data);
@@ -78,8 +247,96 @@ static void remove_obj_node(ObjectPool *pool, void *data)
 		pool->object_list = node->next;
 }
 
+static void insert_obj_dense(ObjectPool *pool, void *data)
+{
+	data_to_node(data)->dense_index = arrbuf_length(&pool->live, sizeof(void*));
+	arrbuf_insert(&pool->live, sizeof(void*), &data);
+}
+
+static void remove_obj_dense(ObjectPool *pool, void *data)
+{
+	void **live = pool->live.data;
+	size_t index = data_to_node(data)->dense_index;
+	size_t last  = arrbuf_length(&pool->live, sizeof(void*)) - 1;
+
+	live[index] = live[last];
+	data_to_node(live[index])->dense_index = index;
+	arrbuf_poptop(&pool->live, sizeof(void*));
+}
+
+static int compare_relocation(const void *a, const void *b)
+{
+	uintptr_t from_a = ((const PageRelocation*)a)->from, from_b = ((const PageRelocation*)b)->from;
+	return (from_a > from_b) - (from_a < from_b);
+}
+
+/* the snapshot isn't aligned */
+static void *saved_page(const unsigned char *pages, size_t i)
+{
+	void *page;
+	memcpy(&page, pages + i * sizeof(void*), sizeof(void*));
+	return page;
+}
+
+static void relocate_slots(ObjectPool *pool, ArrayBuffer *slots)
+{
+	Span span = arrbuf_span(slots);
+	SPAN_FOR(span, slot, void*) {
+		objpool_relocate(pool, slot);
+	}
+}
+
+static void *next_dense(ObjectPool *pool, size_t index)
+{
+	void **live = pool->live.data;
+	size_t length = arrbuf_length(&pool->live, sizeof(void*));
+
+	for(; index < length; index++) {
+		if(index + 1 < length)
+			PREFETCH(data_to_node(live[index + 1]));
+		if(!data_to_node(live[index])->dead)
+			return live[index];
+	}
+	return NULL;
+}
+
 static void *defaultalloc_allocate(size_t bytes, void *user_ptr);
 static void  defaultalloc_deallocate(void *ptr, void *user_ptr);
+static void *defaultalloc_reallocate(void *ptr, size_t old_bytes, size_t new_bytes, void *user_ptr);
+static void *taggedalloc_allocate(size_t bytes, void *user_ptr);
+static void  taggedalloc_deallocate(void *ptr, void *user_ptr);
+static void *taggedalloc_reallocate(void *ptr, size_t old_bytes, size_t new_bytes, void *user_ptr);
+static void *pendingalloc_allocate(size_t bytes, void *user_ptr);
+static void  pendingalloc_deallocate(void *ptr, void *user_ptr);
+static void *pendingalloc_reallocate(void *ptr, size_t old_bytes, size_t new_bytes, void *user_ptr);
+static void *arenaalloc_allocate(size_t bytes, void *user_ptr);
+static void  arenaalloc_deallocate(void *ptr, void *user_ptr);
+static void *arenaalloc_reallocate(void *ptr, size_t old_bytes, size_t new_bytes, void *user_ptr);
+static void *arenaalloc_allocate_aligned(size_t bytes, size_t alignment, void *user_ptr);
+
+static ArenaBlock *new_arena_block(size_t size)
+{
+	/* leave room to align the first allocation */
+	ArenaBlock *block = emalloc(sizeof(ArenaBlock) + size + ARENA_ALIGNMENT);
+	block->size = size + ARENA_ALIGNMENT;
+	return block;
+}
+
+static size_t block_offset(ArenaBlock *block, size_t used, size_t alignment)
+{
+	return align_memory((uintptr_t)block->data + used, alignment) - (uintptr_t)block->data;
+}
+
+static void tag_account(AllocTag tag, ptrdiff_t delta_bytes, int allocations)
+{
+	AllocStats *stats = &alloc_stats[tag];
+
+	stats->live_bytes += delta_bytes;
+	if(stats->live_bytes > stats->peak_bytes)
+		stats->peak_bytes = stats->live_bytes;
+	stats->total_allocations += allocations;
+	frame_allocations[tag]   += allocations;
+}
 
 static inline void check_buffer_initialized(ArrayBuffer *buffer)
 {
@@ -113,12 +370,8 @@ arrbuf_reserve(ArrayBuffer *buffer, size_t size)
 		need_change = 1;
 	}
 
-	if(need_change) {
-		void *newptr = alloct_allocate(&buffer->allocator, buffer->reserved);
-		memcpy(newptr, buffer->data, buffer->size);
-		alloct_deallocate(&buffer->allocator, buffer->data);
-		buffer->data = newptr;
-	}
+	if(need_change)
+		buffer->data = alloct_reallocate(&buffer->allocator, buffer->data, buffer->size, buffer->reserved);
 }
 
 void
@@ -218,6 +471,40 @@ arrbuf_newptr_at(ArrayBuffer *buffer, size_t size, size_t pos)
 	return ptr;
 }
 
+void
+arrbuf_snapshot(ArrayBuffer *out, ArrayBuffer *buffer)
+{
+	arrbuf_insert(out, sizeof(buffer->size), &buffer->size);
+	arrbuf_insert(out, buffer->size, buffer->data);
+}
+
+void
+arrbuf_restore(ArrayBuffer *buffer, Span *snapshot)
+{
+	size_t size;
+
+	span_read(snapshot, &size, sizeof(size));
+	arrbuf_clear(buffer);
+	arrbuf_insert(buffer, size, span_take(snapshot, size));
+}
+
+void *
+span_take(Span *span, size_t size)
+{
+	void *data = span->begin;
+
+	if((size_t)((unsigned char*)span->end - (unsigned char*)span->begin) < size)
+		die("span_take(): %zu bytes past the end\n", size);
+	span->begin = (unsigned char*)span->begin + size;
+	return data;
+}
+
+void
+span_read(Span *span, void *data, size_t size)
+{
+	memcpy(data, span_take(span, size), size);
+}
+
 void
 arrbuf_printf(ArrayBuffer *buffer, const char *fmt, ...)
 {
@@ -459,6 +746,18 @@ strview_str(StrView view)
 {
 	size_t size = (unsigned char*)view.end - (unsigned char*)view.begin;
 	char *ptr = malloc(size + 1);
+	heap_allocations++;
+
+	strview_str_mem(view, ptr, size + 1);
+
+	return ptr;
+}
+
+char *
+strview_str_allocator(StrView view, Allocator *allocator)
+{
+	size_t size = (unsigned char*)view.end - (unsigned char*)view.begin;
+	char *ptr = alloct_allocate(allocator, size + 1);
 
 	strview_str_mem(view, ptr, size + 1);
 
@@ -512,6 +811,7 @@ void *
 _emalloc(size_t size, const char *file, int line)
 {
 	void *ptr = malloc(size);
+	heap_allocations++;
 	if(!ptr)
 		die("malloc failed at %s:%d\n", file, line);
 	return ptr;
@@ -531,6 +831,7 @@ void *
 _erealloc(void *ptr, size_t size, const char *file, int line)
 {
 	ptr = realloc(ptr, size);
+	heap_allocations++;
 	if(!ptr) {
 		die("realloc failed at %s:%d\n", file, line);
 	}
@@ -540,9 +841,23 @@ _erealloc(void *ptr, size_t size, const char *file, int line)
 void 
 objpool_init(ObjectPool *pool, size_t object_size, size_t object_alignment)
 {
-	arrbuf_init(&pool->pages);
-	arrbuf_init(&pool->free_stack);
-	arrbuf_init(&pool->dirty_buffer);
+	objpool_init_allocator(pool, object_size, object_alignment, allocator_default());
+}
+
+void
+objpool_init_allocator(ObjectPool *pool, size_t object_size, size_t object_alignment, Allocator allocator)
+{
+	arrbuf_init_allocator(&pool->pages, allocator);
+	arrbuf_init_allocator(&pool->free_stack, allocator);
+	arrbuf_init_allocator(&pool->dirty_buffer, allocator);
+	arrbuf_init_allocator(&pool->live, allocator);
+	arrbuf_init_allocator(&pool->page_info, allocator);
+	arrbuf_init_allocator(&pool->relocations, allocator);
+	pool->allocator = allocator;
+	pool->dense = false;
+	pool->generation_seed = 0;
+	pool->reclaim_after = 0;
+	pool->reclaimed_pages = 0;
 
 	pool->node_size = align_memory(sizeof(ObjectNode) + object_alignment + sizeof(void*) + object_size, object_alignment);
 	pool->obj_size  = object_size;
@@ -551,6 +866,13 @@ objpool_init(ObjectPool *pool, size_t object_size, size_t object_alignment)
 	objpool_reset(pool);
 }
 
+void
+objpool_init_dense(ObjectPool *pool, size_t object_size, size_t object_alignment, Allocator allocator)
+{
+	objpool_init_allocator(pool, object_size, object_alignment, allocator);
+	pool->dense = true;
+}
+
 void
 objpool_clean(ObjectPool *pool) 
 {
@@ -558,23 +880,47 @@ objpool_clean(ObjectPool *pool)
 	SPAN_FOR(span, data, void*) {
 		if(pool->clean_cbk)
 			pool->clean_cbk(pool, *data);
-		remove_obj_node(pool, *data);
+		if(pool->dense)
+			remove_obj_dense(pool, *data);
+		else
+			remove_obj_node(pool, *data);
 		arrbuf_insert(&pool->free_stack, sizeof(void*), data);
+		node_page(pool, data_to_node(*data))->live--;
+		pool->live_count--;
 	}
 	arrbuf_clear(&pool->dirty_buffer);
+
+	if(pool->reclaim_after)
+		reclaim_idle_pages(pool);
 }
 
 void
 objpool_reset(ObjectPool *pool)
 {
-	Span span = arrbuf_span(&pool->pages);
-	SPAN_FOR(span, page, void*) {
-		free(*page);
+	ObjectPage *info = pool->page_info.data;
+	void **pages = pool->pages.data;
+	uint32_t highest = pool->generation_seed;
+
+	/* the page info goes away, keep the highest generation handed out for the new pages */
+	for(size_t i = 0; i < arrbuf_length(&pool->pages, sizeof(void*)); i++) {
+		uint32_t generation = info[i].generation;
+
+		if(pages[i]) {
+			generation = page_generation(pool, pages[i]);
+			alloct_deallocate_aligned(&pool->allocator, pages[i]);
+		}
+		if(generation > highest)
+			highest = generation;
 	}
 	arrbuf_clear(&pool->pages);
+	arrbuf_clear(&pool->page_info);
 	arrbuf_clear(&pool->free_stack);
 	arrbuf_clear(&pool->dirty_buffer);
+	arrbuf_clear(&pool->live);
+	arrbuf_clear(&pool->relocations);
 	pool->object_list = NULL;
+	pool->live_count = 0;
+	pool->generation_seed = highest;
 	new_obj_page(pool);
 }
 
@@ -583,16 +929,23 @@ objpool_terminate(ObjectPool *pool)
 {
 	Span span = arrbuf_span(&pool->pages);
 	SPAN_FOR(span, page, void*) {
-		free(*page);
+		if(*page)
+			alloct_deallocate_aligned(&pool->allocator, *page);
 	}
 	arrbuf_free(&pool->pages);
+	arrbuf_free(&pool->page_info);
 	arrbuf_free(&pool->free_stack);
 	arrbuf_free(&pool->dirty_buffer);
+	arrbuf_free(&pool->live);
+	arrbuf_free(&pool->relocations);
 }
 
 void *
 objpool_begin(ObjectPool *pool) 
 {
+	if(pool->dense)
+		return next_dense(pool, 0);
+
 	void *ptr = pool->object_list;
 	while(ptr && data_to_node(ptr)->dead) {
 		ptr = data_to_node(ptr)->next;
@@ -603,7 +956,11 @@ objpool_begin(ObjectPool *pool)
 void *
 objpool_next(void *data)
 {
-	void *ptr = data_to_node(data)->next;
+	ObjectNode *node = data_to_node(data);
+	if(node->pool->dense)
+		return next_dense(node->pool, node->dense_index + 1);
+
+	void *ptr = node->next;
 	while(ptr && data_to_node(ptr)->dead) {
 		ptr = data_to_node(ptr)->next;
 	}
@@ -613,17 +970,32 @@ objpool_next(void *data)
 void *
 objpool_new(ObjectPool *pool)
 {
+	ObjectPage *page;
 	void **element = arrbuf_peektop(&pool->free_stack, sizeof(void*));
 	if(!element) {
 		new_obj_page(pool);
 		element = arrbuf_peektop(&pool->free_stack, sizeof(void*));
 	}
 	arrbuf_poptop(&pool->free_stack, sizeof(void*));
+	page = node_page(pool, data_to_node(*element));
+	page->live++;
+	page->idle = 0;
 	data_to_node(*element)->dead = false;
-	insert_obj_node(pool, *element);
+	pool->live_count++;
+	if(pool->dense)
+		insert_obj_dense(pool, *element);
+	else
+		insert_obj_node(pool, *element);
 	return *element;
 }
 
+Span
+objpool_live_span(ObjectPool *pool)
+{
+	assert(pool->dense && "objpool_live_span() on a list pool");
+	return arrbuf_span(&pool->live);
+}
+
 void
 objpool_free(void *object_ptr)
 {
@@ -634,6 +1006,7 @@ objpool_free(void *object_ptr)
 		return;
 	}
 	node->dead = true;
+	node->generation = next_generation(node->generation);
 	
 	arrbuf_insert(&node->pool->dirty_buffer, sizeof(void*), &object_ptr);
 }
@@ -644,6 +1017,175 @@ objpool_is_dead(void *object_ptr)
 	return data_to_node(object_ptr)->dead;
 }
 
+ObjectID
+objpool_id(void *object_ptr)
+{
+	ObjectNode *node = data_to_node(object_ptr);
+	return node->index | (node->generation << OBJECT_ID_INDEX_BITS);
+}
+
+void *
+objpool_from_id(ObjectPool *pool, ObjectID id)
+{
+	size_t index = OBJECT_ID_INDEX(id);
+	size_t page_index = index / OBJECT_ALLOCATOR_PAGE_SIZE;
+	ObjectNode *node;
+
+	if(id == OBJECT_ID_NULL || page_index >= arrbuf_length(&pool->pages, sizeof(void*)))
+		return NULL;
+	if(!((void**)pool->pages.data)[page_index])
+		return NULL;
+
+	node = page_node(pool, ((void**)pool->pages.data)[page_index], index % OBJECT_ALLOCATOR_PAGE_SIZE);
+	if(node->dead || node->generation != OBJECT_ID_GENERATION(id))
+		return NULL;
+	return node_to_data(pool, node);
+}
+
+void
+objpool_set_reclaim(ObjectPool *pool, unsigned int idle_cleans)
+{
+	pool->reclaim_after = idle_cleans;
+}
+
+void
+objpool_snapshot(ObjectPool *pool, ArrayBuffer *out)
+{
+	PoolSnapshot header;
+	void **pages;
+
+	objpool_clean(pool);
+	pages = pool->pages.data;
+	header = (PoolSnapshot){
+		.node_size       = pool->node_size,
+		.page_count      = arrbuf_length(&pool->pages, sizeof(void*)),
+		.object_list     = pool->object_list,
+		.live_count      = pool->live_count,
+		.reclaimed_pages = pool->reclaimed_pages,
+		.generation_seed = pool->generation_seed
+	};
+	arrbuf_insert(out, sizeof(header), &header);
+	arrbuf_insert(out, header.page_count * sizeof(ObjectPage), pool->page_info.data);
+	arrbuf_insert(out, header.page_count * sizeof(void*), pages);
+	for(size_t i = 0; i < header.page_count; i++) {
+		if(pages[i])
+			arrbuf_insert(out, pool->node_size * OBJECT_ALLOCATOR_PAGE_SIZE, pages[i]);
+	}
+	arrbuf_snapshot(out, &pool->free_stack);
+	arrbuf_snapshot(out, &pool->live);
+}
+
+void
+objpool_restore(ObjectPool *pool, Span *snapshot)
+{
+	PoolSnapshot header;
+	void *info;
+	unsigned char *old_pages;
+	void **pages;
+	size_t page_count = arrbuf_length(&pool->pages, sizeof(void*));
+	bool moved;
+
+	span_read(snapshot, &header, sizeof(header));
+	assert(header.node_size == pool->node_size && "objpool_restore() of another pool");
+	/* the nodes are only at the same offsets of every page if the page alignment covers them */
+	assert(pool->alignment <= OBJECT_PAGE_ALIGNMENT);
+	info = span_take(snapshot, header.page_count * sizeof(ObjectPage));
+	old_pages = span_take(snapshot, header.page_count * sizeof(void*));
+
+	/* the pages the pool already has are filled again instead of allocating new ones */
+	pages = pool->pages.data;
+	for(size_t i = 0; i < page_count; i++) {
+		if(pages[i] && (i >= header.page_count || !saved_page(old_pages, i))) {
+			alloct_deallocate_aligned(&pool->allocator, pages[i]);
+			pages[i] = NULL;
+		}
+	}
+	if(page_count > header.page_count)
+		pool->pages.size = header.page_count * sizeof(void*);
+	while(arrbuf_length(&pool->pages, sizeof(void*)) < header.page_count)
+		arrbuf_insert(&pool->pages, sizeof(void*), &(void*){ NULL });
+	arrbuf_clear(&pool->page_info);
+	arrbuf_insert(&pool->page_info, header.page_count * sizeof(ObjectPage), info);
+
+	arrbuf_clear(&pool->relocations);
+	pages = pool->pages.data;
+	for(size_t i = 0; i < header.page_count; i++) {
+		if(!saved_page(old_pages, i))
+			continue;
+		if(!pages[i])
+			pages[i] = alloct_allocate_aligned(&pool->allocator, pool->node_size * OBJECT_ALLOCATOR_PAGE_SIZE, OBJECT_PAGE_ALIGNMENT);
+		if(pages[i] != saved_page(old_pages, i))
+			arrbuf_insert(&pool->relocations, sizeof(PageRelocation), &(PageRelocation){ (uintptr_t)saved_page(old_pages, i), pages[i] });
+	}
+	moved = pool->relocations.size != 0;
+	qsort(pool->relocations.data, arrbuf_length(&pool->relocations, sizeof(PageRelocation)), sizeof(PageRelocation), compare_relocation);
+
+	for(size_t i = 0; i < header.page_count; i++) {
+		if(!pages[i])
+			continue;
+		memcpy(pages[i], span_take(snapshot, pool->node_size * OBJECT_ALLOCATOR_PAGE_SIZE), pool->node_size * OBJECT_ALLOCATOR_PAGE_SIZE);
+		if(!moved)
+			continue;
+		/* while the page is still in cache: the nodes point to each other and to their data, right after them */
+		for(int j = 0; j < OBJECT_ALLOCATOR_PAGE_SIZE; j++) {
+			ObjectNode *node = page_node(pool, pages[i], j);
+			node->pool = pool;
+			((void**)node_to_data(pool, node))[-1] = node;
+			objpool_relocate(pool, (void**)&node->next);
+			objpool_relocate(pool, (void**)&node->prev);
+		}
+	}
+
+	arrbuf_restore(&pool->free_stack, snapshot);
+	arrbuf_restore(&pool->live, snapshot);
+	if(moved) {
+		relocate_slots(pool, &pool->free_stack);
+		relocate_slots(pool, &pool->live);
+	}
+	arrbuf_clear(&pool->dirty_buffer);
+	pool->object_list = header.object_list;
+	objpool_relocate(pool, &pool->object_list);
+	pool->live_count = header.live_count;
+	pool->reclaimed_pages = header.reclaimed_pages;
+	pool->generation_seed = header.generation_seed;
+}
+
+bool
+objpool_relocate(ObjectPool *pool, void **ptr)
+{
+	PageRelocation *relocations = pool->relocations.data;
+	size_t low = 0, high = arrbuf_length(&pool->relocations, sizeof(PageRelocation));
+	uintptr_t address = (uintptr_t)*ptr;
+
+	if(!high)
+		return false;
+	/* the last page that starts at or before the address */
+	while(low < high) {
+		size_t middle = low + (high - low) / 2;
+		if(relocations[middle].from <= address)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	if(!low || address - relocations[low - 1].from >= pool->node_size * OBJECT_ALLOCATOR_PAGE_SIZE)
+		return false;
+	*ptr = (unsigned char*)relocations[low - 1].to + (address - relocations[low - 1].from);
+	return true;
+}
+
+ObjectPoolStats
+objpool_stats(ObjectPool *pool)
+{
+	ObjectPoolStats stats;
+
+	stats.resident_pages  = resident_pages(pool);
+	stats.reclaimed_pages = pool->reclaimed_pages;
+	stats.resident_bytes  = stats.resident_pages * pool->node_size * OBJECT_ALLOCATOR_PAGE_SIZE;
+	stats.live_bytes      = pool->live_count * pool->node_size;
+	stats.free_bytes      = stats.resident_bytes - stats.live_bytes;
+	return stats;
+}
+
 void *
 alloct_allocate(Allocator *a, size_t s)
 {
@@ -656,22 +1198,264 @@ alloct_deallocate(Allocator *a, void *ptr)
 	a->deallocate(ptr, a->userptr);
 }
 
+void *
+alloct_reallocate(Allocator *a, void *ptr, size_t old_size, size_t new_size)
+{
+	void *new_ptr;
+
+	if(a->reallocate)
+		return a->reallocate(ptr, old_size, new_size, a->userptr);
+
+	new_ptr = a->allocate(new_size, a->userptr);
+	memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+	a->deallocate(ptr, a->userptr);
+	return new_ptr;
+}
+
+void *
+alloct_allocate_aligned(Allocator *a, size_t size, size_t alignment)
+{
+	void *ptr, *aligned;
+
+	if(a->allocate_aligned)
+		return a->allocate_aligned(size, alignment, a->userptr);
+
+	/* keep the pointer that came from allocate right before the aligned block */
+	ptr = a->allocate(size + alignment + sizeof(void*), a->userptr);
+	aligned = (void*)align_memory((uintptr_t)ptr + sizeof(void*), alignment);
+	((void**)aligned)[-1] = ptr;
+	return aligned;
+}
+
+void
+alloct_deallocate_aligned(Allocator *a, void *ptr)
+{
+	if(a->allocate_aligned) {
+		if(a->deallocate_aligned)
+			a->deallocate_aligned(ptr, a->userptr);
+		return;
+	}
+	a->deallocate(((void**)ptr)[-1], a->userptr);
+}
+
 Allocator 
 allocator_default(void)
 {
 	return (Allocator) {
 		.allocate = defaultalloc_allocate,
-		.deallocate = defaultalloc_deallocate
+		.deallocate = defaultalloc_deallocate,
+		.reallocate = defaultalloc_reallocate
+	};
+}
+
+Allocator
+allocator_tagged(AllocTag tag)
+{
+	return (Allocator) {
+		.userptr = (void*)(uintptr_t)tag,
+		.allocate = taggedalloc_allocate,
+		.deallocate = taggedalloc_deallocate,
+		.reallocate = taggedalloc_reallocate
 	};
 }
 
+Allocator
+allocator_pending(PendingAlloc *pending)
+{
+	return (Allocator) {
+		.userptr = pending,
+		.allocate = pendingalloc_allocate,
+		.deallocate = pendingalloc_deallocate,
+		.reallocate = pendingalloc_reallocate
+	};
+}
+
+void
+alloc_pending_account(PendingAlloc *pending)
+{
+	heap_allocations += pending->allocations;
+	tag_account(pending->tag, pending->delta_bytes, pending->allocations);
+	pending->delta_bytes = 0;
+	pending->allocations = 0;
+}
+
+AllocStats
+alloc_tag_stats(AllocTag tag)
+{
+	return alloc_stats[tag];
+}
+
+const char *
+alloc_tag_name(AllocTag tag)
+{
+	return alloc_tag_names[tag];
+}
+
+void
+alloc_stats_new_frame(void)
+{
+	for(int i = 0; i < LAST_ALLOC_TAG; i++) {
+		alloc_stats[i].frame_allocations = frame_allocations[i];
+		frame_allocations[i] = 0;
+	}
+}
+
 void *
 defaultalloc_allocate(size_t bytes, void *user_ptr)
 {
 	(void)user_ptr;
+	heap_allocations++;
 	return malloc(bytes);
 }
 
+void
+arena_init(Arena *arena, size_t initial_size)
+{
+	ArenaBlock *block = new_arena_block(initial_size);
+
+	arrbuf_init(&arena->blocks);
+	arrbuf_insert(&arena->blocks, sizeof(ArenaBlock*), &block);
+	arena->block = 0;
+	arena->used  = 0;
+}
+
+void
+arena_terminate(Arena *arena)
+{
+	Span span = arrbuf_span(&arena->blocks);
+	SPAN_FOR(span, block, ArenaBlock*) {
+		efree(*block);
+	}
+	arrbuf_free(&arena->blocks);
+}
+
+void *
+arena_allocate(Arena *arena, size_t size)
+{
+	return arena_allocate_aligned(arena, size, ARENA_ALIGNMENT);
+}
+
+void *
+arena_allocate_aligned(Arena *arena, size_t size, size_t alignment)
+{
+	ArenaBlock **blocks = arena->blocks.data;
+	size_t block_count  = arrbuf_length(&arena->blocks, sizeof(ArenaBlock*));
+	size_t offset       = block_offset(blocks[arena->block], arena->used, alignment);
+
+	while(offset + size > blocks[arena->block]->size) {
+		arena->block++;
+
+		if(arena->block == block_count) {
+			size_t new_size = blocks[block_count - 1]->size * 2;
+			ArenaBlock *block;
+
+			while(new_size < size + alignment)
+				new_size *= 2;
+			block = new_arena_block(new_size);
+			arrbuf_insert(&arena->blocks, sizeof(ArenaBlock*), &block);
+			blocks = arena->blocks.data;
+			block_count++;
+		}
+		offset = block_offset(blocks[arena->block], 0, alignment);
+	}
+
+	arena->used = offset + size;
+	return blocks[arena->block]->data + offset;
+}
+
+void
+arena_reset(Arena *arena)
+{
+	ArenaBlock **blocks = arena->blocks.data;
+	size_t block_count  = arrbuf_length(&arena->blocks, sizeof(ArenaBlock*));
+	size_t total_size   = 0;
+
+	arena->block = 0;
+	arena->used  = 0;
+	if(block_count == 1)
+		return;
+
+	for(size_t i = 0; i < block_count; i++) {
+		total_size += blocks[i]->size;
+		efree(blocks[i]);
+	}
+	blocks[0] = new_arena_block(total_size);
+	arena->blocks.size = sizeof(ArenaBlock*);
+}
+
+ArenaCheckpoint
+arena_checkpoint(Arena *arena)
+{
+	return (ArenaCheckpoint) {
+		.block = arena->block,
+		.used  = arena->used
+	};
+}
+
+void
+arena_rewind(Arena *arena, ArenaCheckpoint checkpoint)
+{
+	arena->block = checkpoint.block;
+	arena->used  = checkpoint.used;
+}
+
+Allocator
+arena_allocator(Arena *arena)
+{
+	return (Allocator) {
+		.userptr = arena,
+		.allocate = arenaalloc_allocate,
+		.deallocate = arenaalloc_deallocate,
+		.reallocate = arenaalloc_reallocate,
+		.allocate_aligned = arenaalloc_allocate_aligned,
+		.deallocate_aligned = arenaalloc_deallocate
+	};
+}
+
+void *
+arenaalloc_allocate(size_t bytes, void *user_ptr)
+{
+	return arena_allocate(user_ptr, bytes);
+}
+
+void
+arenaalloc_deallocate(void *ptr, void *user_ptr)
+{
+	(void)ptr;
+	(void)user_ptr;
+}
+
+void *
+arenaalloc_reallocate(void *ptr, size_t old_bytes, size_t new_bytes, void *user_ptr)
+{
+	Arena *arena = user_ptr;
+	ArenaBlock *block = ((ArenaBlock**)arena->blocks.data)[arena->block];
+	void *new_ptr;
+
+	/* the last allocation can just grow in place */
+	if((unsigned char*)ptr + old_bytes == block->data + arena->used
+	&& (size_t)((unsigned char*)ptr - block->data) + new_bytes <= block->size) {
+		arena->used = ((unsigned char*)ptr - block->data) + new_bytes;
+		return ptr;
+	}
+
+	new_ptr = arena_allocate(arena, new_bytes);
+	memcpy(new_ptr, ptr, old_bytes < new_bytes ? old_bytes : new_bytes);
+	return new_ptr;
+}
+
+void *
+arenaalloc_allocate_aligned(size_t bytes, size_t alignment, void *user_ptr)
+{
+	return arena_allocate_aligned(user_ptr, bytes, alignment);
+}
+
+size_t
+heap_allocation_count(void)
+{
+	return heap_allocations;
+}
+
 void 
 defaultalloc_deallocate(void *ptr, void *user_ptr)
 {
@@ -679,6 +1463,100 @@ defaultalloc_deallocate(void *ptr, void *user_ptr)
 	free(ptr);
 }
 
+void *
+defaultalloc_reallocate(void *ptr, size_t old_bytes, size_t new_bytes, void *user_ptr)
+{
+	(void)old_bytes;
+	(void)user_ptr;
+	heap_allocations++;
+	return realloc(ptr, new_bytes);
+}
+
+void *
+taggedalloc_allocate(size_t bytes, void *user_ptr)
+{
+	unsigned char *header = malloc(bytes + TAG_HEADER_SIZE);
+
+	heap_allocations++;
+	if(!header)
+		return NULL;
+	*(size_t*)header = bytes;
+	tag_account((AllocTag)(uintptr_t)user_ptr, bytes, 1);
+	return header + TAG_HEADER_SIZE;
+}
+
+void
+taggedalloc_deallocate(void *ptr, void *user_ptr)
+{
+	unsigned char *header;
+
+	if(!ptr)
+		return;
+	header = (unsigned char*)ptr - TAG_HEADER_SIZE;
+	tag_account((AllocTag)(uintptr_t)user_ptr, -(ptrdiff_t)*(size_t*)header, 0);
+	free(header);
+}
+
+void *
+taggedalloc_reallocate(void *ptr, size_t old_bytes, size_t new_bytes, void *user_ptr)
+{
+	unsigned char *header = (unsigned char*)ptr - TAG_HEADER_SIZE;
+	size_t previous_bytes = *(size_t*)header;
+	(void)old_bytes;
+
+	heap_allocations++;
+	header = realloc(header, new_bytes + TAG_HEADER_SIZE);
+	if(!header)
+		return NULL;
+	*(size_t*)header = new_bytes;
+	tag_account((AllocTag)(uintptr_t)user_ptr, (ptrdiff_t)new_bytes - (ptrdiff_t)previous_bytes, 1);
+	return header + TAG_HEADER_SIZE;
+}
+
+void *
+pendingalloc_allocate(size_t bytes, void *user_ptr)
+{
+	PendingAlloc *pending = user_ptr;
+	unsigned char *header = malloc(bytes + TAG_HEADER_SIZE);
+
+	pending->allocations++;
+	if(!header)
+		return NULL;
+	*(size_t*)header = bytes;
+	pending->delta_bytes += bytes;
+	return header + TAG_HEADER_SIZE;
+}
+
+void
+pendingalloc_deallocate(void *ptr, void *user_ptr)
+{
+	PendingAlloc *pending = user_ptr;
+	unsigned char *header;
+
+	if(!ptr)
+		return;
+	header = (unsigned char*)ptr - TAG_HEADER_SIZE;
+	pending->delta_bytes -= *(size_t*)header;
+	free(header);
+}
+
+void *
+pendingalloc_reallocate(void *ptr, size_t old_bytes, size_t new_bytes, void *user_ptr)
+{
+	PendingAlloc *pending = user_ptr;
+	unsigned char *header = (unsigned char*)ptr - TAG_HEADER_SIZE;
+	size_t previous_bytes = *(size_t*)header;
+	(void)old_bytes;
+
+	pending->allocations++;
+	header = realloc(header, new_bytes + TAG_HEADER_SIZE);
+	if(!header)
+		return NULL;
+	*(size_t*)header = new_bytes;
+	pending->delta_bytes += (ptrdiff_t)new_bytes - (ptrdiff_t)previous_bytes;
+	return header + TAG_HEADER_SIZE;
+}
+
 int 
 utf8_decode(StrView str)
 {
@@ -0,0 +1,22 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <SDL.h>
+
+/* shared by the benchmarks in tools/, built with make bench */
+
+static inline double
+bench_now(void)
+{
+	return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+}
+
+/* same sequence on every platform, so the runs of two machines can be compared */
+static inline float
+bench_random(unsigned int *state)
+{
+	*state = *state * 1103515245u + 12345u;
+	return (*state >> 8) / (float)(1 << 24);
+}
+
+#endif
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "physics.h"
+#include "jobs.h"
+#include "bench.h"
+
+/*
+ * a size x size map with border walls and a pillar every 4 tiles as static
+ * bodies, and moving 1x1 bodies pushed around at random. Runs the same scene
+ * with the default cell size and with phx_auto_cell_size().
+ *
+ * bench_broadphase [size] [bodies] [steps] [workers]
+ */
+
+#define STEP_RATE 480.0f
+#define PUSH      200.0f
+
+typedef struct {
+	int size, body_count, steps;
+} BroadphaseScene;
+
+static void run_scene(BroadphaseScene *scene, bool auto_cell_size);
+static void build_scene(BroadphaseScene *scene, Body **bodies);
+
+int
+main(int argc, char **argv)
+{
+	BroadphaseScene scene = {
+		.size       = argc > 1 ? atoi(argv[1]) : 200,
+		.body_count = argc > 2 ? atoi(argv[2]) : 2000,
+		.steps      = argc > 3 ? atoi(argv[3]) : 2000,
+	};
+
+	jobs_init(argc > 4 ? atoi(argv[4]) : SDL_GetCPUCount() - 1);
+	phx_init();
+	printf("map %dx%d, %d bodies, %d steps at %.0f Hz, %d workers\n",
+		scene.size, scene.size, scene.body_count, scene.steps, STEP_RATE, jobs_worker_count());
+	run_scene(&scene, false);
+	run_scene(&scene, true);
+	phx_end();
+	jobs_end();
+	return 0;
+}
+
+void
+run_scene(BroadphaseScene *scene, bool auto_cell_size)
+{
+	Body **bodies = emalloc(sizeof(*bodies) * scene->body_count);
+	unsigned int seed = 2;
+	int escaped = 0;
+	double begin, time;
+	PhxStats stats;
+
+	phx_reset();
+	phx_set_rate(STEP_RATE);
+	phx_set_cell_size(PHX_DEFAULT_CELL_SIZE);
+	build_scene(scene, bodies);
+	if(auto_cell_size)
+		phx_auto_cell_size();
+
+	begin = bench_now();
+	for(int i = 0; i < scene->steps; i++) {
+		for(int j = 0; j < scene->body_count; j++) {
+			float *accel = phx_accel(bodies[j]);
+			accel[0] = (bench_random(&seed) - 0.5f) * PUSH;
+			accel[1] = (bench_random(&seed) - 0.5f) * PUSH;
+		}
+		phx_update(1.0f / STEP_RATE);
+	}
+	time = (bench_now() - begin) / scene->steps;
+	stats = phx_stats();
+
+	for(int i = 0; i < scene->body_count; i++) {
+		float *position = phx_position(bodies[i]);
+		escaped += position[0] < 0.5f || position[1] < 0.5f
+			|| position[0] > scene->size - 0.5f || position[1] > scene->size - 0.5f;
+	}
+	printf("cell size %5.2f: %7.3f ms/step, %zu pair tests, %zu contacts, %zu grid nodes, %d escaped\n",
+		phx_cell_size(), time * 1e3, stats.pair_tests, stats.contacts, stats.grid_nodes, escaped);
+	free(bodies);
+}
+
+void
+build_scene(BroadphaseScene *scene, Body **bodies)
+{
+	unsigned int seed = 1;
+
+	for(int x = 0; x < scene->size; x++) {
+		for(int y = 0; y < scene->size; y++) {
+			bool border = x == 0 || y == 0 || x == scene->size - 1 || y == scene->size - 1;
+			if(!border && (x % 4 || y % 4))
+				continue;
+
+			Body *wall = phx_new();
+			wall->is_static = true;
+			wall->collision_layer = wall->solve_layer = PHX_LAYER_MAP_BIT;
+			phx_position(wall)[0] = x + 0.5f;
+			phx_position(wall)[1] = y + 0.5f;
+			wall->half_size[0] = wall->half_size[1] = 0.5f;
+		}
+	}
+
+	for(int i = 0; i < scene->body_count; i++) {
+		Body *body = bodies[i] = phx_new();
+		float *position = phx_position(body), *velocity = phx_velocity(body);
+		position[0] = 1.0f + bench_random(&seed) * (scene->size - 2);
+		position[1] = 1.0f + bench_random(&seed) * (scene->size - 2);
+		velocity[0] = bench_random(&seed) * 4.0f - 2.0f;
+		velocity[1] = bench_random(&seed) * 4.0f - 2.0f;
+		body->half_size[0] = body->half_size[1] = 0.5f;
+		body->mass = 10.0f;
+		body->restitution = 0.01f;
+		phx_set_damping(body, 1.0f);
+		body->collision_layer = body->solve_layer = PHX_LAYER_ENTITIES_BIT;
+		body->collision_mask  = body->solve_mask  = PHX_LAYER_ENTITIES_BIT | PHX_LAYER_MAP_BIT;
+	}
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "global.h"
+#include "physics.h"
+#include "graphics.h"
+#include "audio.h"
+#include "events.h"
+#include "timers.h"
+#include "jobs.h"
+#include "entity.h"
+#include "bench.h"
+
+/*
+ * ent_update and ent_render over a mix of 50% dummies, 40% particles and 10%
+ * damage numbers, best of RUNS runs of FRAMES frames. The scene is the real
+ * one, only what would draw or play a sound is stubbed out below. Frames are
+ * FRAME_TIME long so nothing expires while it is timed.
+ *
+ * bench_entities [entities] [workers]
+ */
+
+#define RUNS       5
+#define FRAMES     60
+#define FRAME_TIME (1.0f / 600.0f)
+#define MAP_SIZE   1000
+
+Global GLOBAL;
+
+static void spawn_entities(int count);
+
+int
+main(int argc, char **argv)
+{
+	int count = argc > 1 ? atoi(argv[1]) : 50000;
+	double best = INFINITY;
+	ObjectPoolStats pool;
+
+	jobs_init(argc > 2 ? atoi(argv[2]) : SDL_GetCPUCount() - 1);
+	gfx_scene_setup();
+	phx_init();
+	timers_init();
+	ent_init();
+
+	spawn_entities(count);
+	phx_update(1.0f / PHX_DEFAULT_RATE);
+	ent_update(FRAME_TIME);
+
+	for(int run = 0; run < RUNS; run++) {
+		double begin = bench_now();
+		for(int frame = 0; frame < FRAMES; frame++) {
+			ent_update(FRAME_TIME);
+			ent_render();
+		}
+		best = fmin(best, (bench_now() - begin) / FRAMES);
+	}
+
+	pool = ent_pool_stats();
+	printf("%d entities, %d workers: %.3f ms/frame, %.1f ns/entity\n",
+		count, jobs_worker_count(), best * 1e3, best * 1e9 / count);
+	printf("entity pools: %zu live bytes, %zu resident bytes, %zu particles\n",
+		pool.live_bytes, pool.resident_bytes, ent_particles_count());
+
+	ent_end();
+	phx_end();
+	jobs_end();
+	return 0;
+}
+
+void
+spawn_entities(int count)
+{
+	unsigned int seed = 1;
+
+	for(int i = 0; i < count; i++) {
+		vec2 position = { bench_random(&seed) * MAP_SIZE, bench_random(&seed) * MAP_SIZE };
+
+		switch(i % 10) {
+		case 0: case 1: case 2: case 3: case 4:
+			ent_dummy_new(position);
+			break;
+		case 5: case 6: case 7: case 8:
+			ent_shot_particles(position, (vec2){ 1.0, 0.0 }, (vec4){ 1.0, 1.0, 1.0, 1.0 }, 1e9, 1);
+			break;
+		default:
+			ent_damage_number(position, -1.0f);
+			break;
+		}
+	}
+}
+
+/* headless, nothing is drawn or played */
+void gfx_begin(void) { }
+void gfx_end(void) { }
+void gfx_flush(void) { }
+void gfx_push_font2(Font font, vec2 position, float height, vec4 color, const char *fmt, ...) { (void)font; (void)position; (void)height; (void)color; (void)fmt; }
+void gfx_push_line(vec2 p1, vec2 p2, float thickness, vec4 color) { (void)p1; (void)p2; (void)thickness; (void)color; }
+void gfx_push_sprite_batch(TextureStamp *stamp, vec2 half_size, size_t count, float *x, float *y, float *rotation, vec4 *color) { (void)stamp; (void)half_size; (void)count; (void)x; (void)y; (void)rotation; (void)color; }
+void gfx_push_texture_rect(TextureStamp *texture, vec2 position, vec2 size, vec2 uv_scale, float rotation, vec4 color) { (void)texture; (void)position; (void)size; (void)uv_scale; (void)rotation; (void)color; }
+void gfx_pixel_to_world(vec2 pixel, vec2 world_out) { vec2_dup(world_out, pixel); }
+void gfx_world_to_pixel(vec2 world, vec2 pixel_out) { vec2_dup(pixel_out, world); }
+void gfx_world_scale_to_pixel_scale(vec2 in, vec2 out) { vec2_dup(out, in); }
+Rectangle gfx_window_rectangle(void) { return (Rectangle){ .half_size = { MAP_SIZE, MAP_SIZE } }; }
+TextureStamp get_sprite(SpriteType sprite, int sprite_x, int sprite_y) { (void)sprite; (void)sprite_x; (void)sprite_y; return (TextureStamp){ 0 }; }
+void audio_sfx_play(Mixer mixer, Sound sound, float freq_scale) { (void)mixer; (void)sound; (void)freq_scale; }
+void event_emit(Event event, const void *data) { (void)event; (void)data; }
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "physics.h"
+#include "jobs.h"
+#include "bench.h"
+
+/*
+ * dynamic bodies that never touch anything, so a step is mostly the walk over
+ * the bodies and their integration. Inactive bodies are not binned and only
+ * integrated, active ones go through the whole step. The checksum of the
+ * positions and velocities tells if two builds integrate the same.
+ *
+ * bench_integrate [bodies] [steps] [workers]
+ */
+
+#define STEP_RATE 480.0f
+#define MAP_SIZE  1000.0f
+
+typedef struct {
+	int body_count, steps;
+} IntegrateScene;
+
+static void run_scene(IntegrateScene *scene, bool active);
+
+int
+main(int argc, char **argv)
+{
+	IntegrateScene scene = {
+		.body_count = argc > 1 ? atoi(argv[1]) : 10000,
+		.steps      = argc > 2 ? atoi(argv[2]) : 1000,
+	};
+
+	jobs_init(argc > 3 ? atoi(argv[3]) : SDL_GetCPUCount() - 1);
+	phx_init();
+	printf("%d bodies, %d steps at %.0f Hz, %d workers\n",
+		scene.body_count, scene.steps, STEP_RATE, jobs_worker_count());
+	run_scene(&scene, false);
+	run_scene(&scene, true);
+	phx_end();
+	jobs_end();
+	return 0;
+}
+
+void
+run_scene(IntegrateScene *scene, bool active)
+{
+	Body **bodies = emalloc(sizeof(*bodies) * scene->body_count);
+	unsigned int seed = 1;
+	double begin, time, checksum = 0;
+
+	phx_reset();
+	phx_set_rate(STEP_RATE);
+	for(int i = 0; i < scene->body_count; i++) {
+		Body *body = bodies[i] = phx_new();
+		float *position = phx_position(body), *velocity = phx_velocity(body);
+		position[0] = bench_random(&seed) * MAP_SIZE;
+		position[1] = bench_random(&seed) * MAP_SIZE;
+		/* fast enough to never fall asleep */
+		velocity[0] = 1.0f + bench_random(&seed) * 2.0f;
+		velocity[1] = 1.0f + bench_random(&seed) * 2.0f;
+		body->half_size[0] = body->half_size[1] = 0.5f;
+		body->mass = 1.0f;
+		body->active = active;
+		phx_set_damping(body, 0.5f);
+	}
+
+	begin = bench_now();
+	for(int i = 0; i < scene->steps; i++)
+		phx_update(1.0f / STEP_RATE);
+	time = (bench_now() - begin) / scene->steps;
+
+	for(int i = 0; i < scene->body_count; i++) {
+		float *position = phx_position(bodies[i]), *velocity = phx_velocity(bodies[i]);
+		checksum += position[0] + position[1] + velocity[0] + velocity[1];
+	}
+	printf("%-9s %7.3f ms/step, %5.2f ns/body, checksum %.6f\n", active ? "active:" : "inactive:",
+		time * 1e3, time * 1e9 / scene->body_count, checksum);
+	free(bodies);
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "util.h"
+#include "bench.h"
+
+/*
+ * walks a linked list pool and a dense pool after a few rounds of churn, so
+ * the list is in allocation order and not in memory order, like after a
+ * while of playing. Prints the time of one update per object.
+ */
+
+#define CHURN_ROUNDS 4
+/* objects updated per size, the iterations are this over the count */
+#define UPDATES      20000000
+
+typedef struct {
+	float position[2], velocity[2], accel[2];
+	float padding[10];
+} BenchObject;
+
+static double run_pool(bool dense, int count);
+static BenchObject *new_object(ObjectPool *pool);
+
+int
+main(void)
+{
+	static const int counts[] = { 1000, 10000, 100000 };
+
+	printf("%8s %14s %14s\n", "objects", "list ns/obj", "dense ns/obj");
+	for(size_t i = 0; i < LENGTH(counts); i++) {
+		double list  = run_pool(false, counts[i]);
+		double dense = run_pool(true, counts[i]);
+		printf("%8d %14.2f %14.2f\n", counts[i], list, dense);
+	}
+	return 0;
+}
+
+double
+run_pool(bool dense, int count)
+{
+	/* zeroed, objpool_init leaves clean_cbk to the caller */
+	ObjectPool pool = { 0 };
+	BenchObject **objects = emalloc(sizeof(*objects) * count);
+	unsigned int seed = 1;
+	int iterations = UPDATES / count;
+	double begin, time;
+
+	if(dense)
+		objpool_init_dense(&pool, sizeof(BenchObject), DEFAULT_ALIGNMENT, allocator_default());
+	else
+		objpool_init(&pool, sizeof(BenchObject), DEFAULT_ALIGNMENT);
+
+	for(int i = 0; i < count; i++)
+		objects[i] = new_object(&pool);
+	for(int round = 0; round < CHURN_ROUNDS; round++) {
+		for(int i = 0; i < count; i++) {
+			if(bench_random(&seed) < 0.5f) {
+				objpool_free(objects[i]);
+				objects[i] = NULL;
+			}
+		}
+		objpool_clean(&pool);
+		for(int i = 0; i < count; i++)
+			if(!objects[i])
+				objects[i] = new_object(&pool);
+	}
+
+	begin = bench_now();
+	for(int i = 0; i < iterations; i++) {
+		for(BenchObject *object = objpool_begin(&pool); object; object = objpool_next(object)) {
+			object->velocity[0] += object->accel[0];
+			object->position[0] += object->velocity[0] * 0.01f;
+		}
+	}
+	time = (bench_now() - begin) / iterations / count * 1e9;
+
+	objpool_terminate(&pool);
+	free(objects);
+	return time;
+}
+
+BenchObject *
+new_object(ObjectPool *pool)
+{
+	BenchObject *object = objpool_new(pool);
+	memset(object, 0, sizeof(*object));
+	object->accel[0] = 1.0f;
+	return object;
+}